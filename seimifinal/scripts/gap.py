@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+华为嵌入式软件大赛复赛 - 最优性差距统计
+对每个小规模数据，先用 2.0 的 --exact 分支定界求出最优值(搜索未完成时为所有方案的得分上界)，
+再运行各版本程序并精确评分，逐个数据输出各版本与最优值的差距
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import tempfile
+from pathlib import Path
+
+from scorer import score_files
+
+os.chdir(Path(__file__).parent)
+
+OPTIMUM_RE = re.compile(r"exact optimum: ([0-9.eE+-]+)")
+BEST_RE = re.compile(r"exact best: ([0-9.eE+-]+), bound: ([0-9.eE+-]+)")
+
+
+def run_program(command, input_file, output_file, timeout):
+    """运行程序，返回标准错误输出；失败时返回 None"""
+    with open(input_file, "r", encoding="utf-8") as infile:
+        with open(output_file, "w", encoding="utf-8") as outfile:
+            try:
+                result = subprocess.run(
+                    command,
+                    stdin=infile,
+                    stdout=outfile,
+                    stderr=subprocess.PIPE,
+                    timeout=timeout,
+                    text=True,
+                )
+            except subprocess.TimeoutExpired:
+                return None
+    return result.stderr if result.returncode == 0 else None
+
+
+def exact_reference(exact_exe, input_file, output_file, nodes, timeout):
+    """返回 (最优值或上界, 是否已证明最优)，失败时返回 None"""
+    stderr = run_program(
+        # 不限时，节点上限决定搜索量
+        [exact_exe, "--exact", "--exact-nodes", str(nodes), "--time-limit", "0", "--report"],
+        input_file,
+        output_file,
+        timeout,
+    )
+    if stderr is None:
+        return None
+    match = OPTIMUM_RE.search(stderr)
+    if match:
+        return float(match.group(1)), True
+    match = BEST_RE.search(stderr)
+    if match:
+        return float(match.group(2)), False
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="各版本与精确最优值的差距")
+    parser.add_argument("inputs", nargs="+", help="输入数据文件(不超过20个用户)")
+    parser.add_argument("--exact", default="../src/2.0/main.exe", help="带 --exact 的 2.0 程序")
+    parser.add_argument(
+        "--version",
+        action="append",
+        default=[],
+        metavar="名称=程序",
+        help="参与比较的版本，可重复，如 2.2=../src/2.2/main.exe",
+    )
+    parser.add_argument("--nodes", type=int, default=20000000, help="分支定界的节点上限")
+    parser.add_argument("--timeout", type=int, default=600, help="每次运行的超时秒数")
+    args = parser.parse_args()
+
+    versions = [item.split("=", 1) for item in args.version]
+    header = f"{'数据':<20} {'最优值':>14}" + "".join(f" {name:>22}" for name, _ in versions)
+    print(header)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        output_file = Path(tmp) / "output.out"
+        for input_file in args.inputs:
+            reference = exact_reference(args.exact, input_file, output_file, args.nodes, args.timeout)
+            if reference is None:
+                print(f"{input_file:<20} {'求解失败':>14}")
+                continue
+            value, proven = reference
+            # 没能证明最优时参考值为上界，差距也只是上界
+            mark = "" if proven else "≤"
+            row = f"{input_file:<20} {mark + format(value, '.3f'):>14}"
+            for _, exe in versions:
+                if run_program([exe], input_file, output_file, args.timeout) is None:
+                    row += f" {'运行失败':>22}"
+                    continue
+                result = score_files(input_file, output_file)
+                if result["verdict"] != "OK":
+                    row += f" {result['verdict']:>22}"
+                    continue
+                gap = (value - result["score"]) / value * 100
+                row += f" {result['score']:>12.3f} ({mark}{gap:.4f}%)"
+            print(row)
+
+
+if __name__ == "__main__":
+    main()
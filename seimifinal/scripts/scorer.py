@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+华为嵌入式软件大赛复赛 - 精确评分接口
+通过 ctypes 调用 sim/libscorer.so，库不存在或比源码旧时自动用 g++ 编译
+"""
+
+import ctypes
+import subprocess
+from pathlib import Path
+
+SIM_DIR = Path(__file__).resolve().parent.parent / "sim"
+LIB_PATH = SIM_DIR / "libscorer.so"
+SOURCES = ["scorer.cpp", "simulator.cpp"]
+HEADERS = ["scorer.h", "simulator.h"]
+
+
+class ScoreResult(ctypes.Structure):
+    _fields_ = [
+        ("verdict", ctypes.c_int),
+        ("bad_user", ctypes.c_int),
+        ("M", ctypes.c_int),
+        ("K", ctypes.c_int),
+        ("score", ctypes.c_double),
+    ]
+
+
+_lib = None
+
+
+def build_library():
+    """编译 libscorer.so"""
+    cmd = ["g++", "-O2", "-std=c++17", "-shared", "-fPIC", "-o", str(LIB_PATH)]
+    cmd += [str(SIM_DIR / src) for src in SOURCES]
+    subprocess.run(cmd, check=True)
+
+
+def load_library():
+    """加载评分库，必要时先编译"""
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    newest_source = max((SIM_DIR / f).stat().st_mtime for f in SOURCES + HEADERS)
+    if not LIB_PATH.exists() or LIB_PATH.stat().st_mtime < newest_source:
+        build_library()
+
+    lib = ctypes.CDLL(str(LIB_PATH))
+    lib.lc_score_files.argtypes = [
+        ctypes.c_char_p,
+        ctypes.c_char_p,
+        ctypes.POINTER(ScoreResult),
+        ctypes.POINTER(ctypes.c_longlong),
+        ctypes.POINTER(ctypes.c_int),
+        ctypes.c_int,
+    ]
+    lib.lc_score_files.restype = ctypes.c_int
+    lib.lc_verdict_name.argtypes = [ctypes.c_int]
+    lib.lc_verdict_name.restype = ctypes.c_char_p
+    _lib = lib
+    return lib
+
+
+def score_files(input_file, output_file, max_users=500):
+    """
+    精确评分
+    返回 dict: verdict(错误类型名称, 合法时为 "OK"), bad_user, K, score, end, move
+    """
+    lib = load_library()
+    result = ScoreResult()
+    end = (ctypes.c_longlong * max_users)()
+    move = (ctypes.c_int * max_users)()
+    code = lib.lc_score_files(
+        str(input_file).encode(),
+        str(output_file).encode(),
+        ctypes.byref(result),
+        end,
+        move,
+        max_users,
+    )
+    users = min(result.M, max_users) if code == 0 else 0
+    return {
+        "verdict": lib.lc_verdict_name(code).decode(),
+        "bad_user": result.bad_user,
+        "M": result.M,
+        "K": result.K,
+        "score": result.score,
+        "end": list(end[:users]),
+        "move": list(move[:users]),
+    }
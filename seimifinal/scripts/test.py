@@ -10,6 +10,8 @@ import sys
 import os
 from pathlib import Path
 
+from scorer import score_files
+
 # 重定向工作目录为当前脚本所在目录
 os.chdir(Path(__file__).parent)
 
@@ -49,6 +51,12 @@ def main():
             with open(output_filename, "r", encoding="utf-8") as f:
                 line_count = len(f.readlines())
             print(f"✅ 成功! 输出 {line_count} 行到 {output_filename}")
+
+            result = score_files(input_filename, output_filename)
+            if result["verdict"] == "OK":
+                print(f"🏆 得分: {result['score']:.1f} (超时用户: {result['K']})")
+            else:
+                print(f"❌ {result['verdict']} (用户{result['bad_user'] + 1})")
         else:
             print(f"❌ 程序返回错误码: {result.returncode}")
             if result.stderr:
@@ -0,0 +1,34 @@
+// 流体松弛上界: 输出任何合法调度方案得分的上界
+// 用法: ./bound.exe data.in [分桶毫秒数，默认100]
+
+#include "fluid.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+int main(int argc, char **argv)
+{
+    const char *input_file = argc > 1 ? argv[1] : "data.in";
+    int bucket = argc > 2 ? std::atoi(argv[2]) : 100;
+    if (bucket <= 0)
+    {
+        std::fprintf(stderr, "分桶毫秒数必须为正: %s\n", argv[2]);
+        return 1;
+    }
+
+    std::ifstream input(input_file);
+    sim::Instance inst;
+    if (!input || !sim::read_instance(input, inst))
+    {
+        std::fprintf(stderr, "读取输入失败: %s\n", input_file);
+        return 1;
+    }
+
+    sim::FluidBound bound = sim::fluid_bound(inst, bucket);
+    std::printf("样本总数: %lld, 时间窗内最大流: %lld\n", bound.total_samples, bound.on_time_flow);
+    std::printf("超时用户数下界: %d, 最大超时比例下界: %.4f\n", bound.min_late_users, bound.min_max_lateness);
+    std::printf("不受竞争时得分项之和: %.4f\n", bound.isolated_terms);
+    std::printf("得分上界: %.3f\n", bound.score);
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include "fluid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace sim
+{
+
+    namespace
+    {
+
+        const long long INF = std::numeric_limits<long long>::max() / 4;
+
+        // Dinic 最大流
+        class MaxFlow
+        {
+        public:
+            explicit MaxFlow(int n) : head(n, -1), level(n), cursor(n) {}
+
+            int add_node()
+            {
+                head.push_back(-1);
+                level.push_back(0);
+                cursor.push_back(0);
+                return static_cast<int>(head.size()) - 1;
+            }
+
+            void add_edge(int from, int to, long long cap)
+            {
+                edges.push_back({to, head[from], cap});
+                head[from] = static_cast<int>(edges.size()) - 1;
+                edges.push_back({from, head[to], 0});
+                head[to] = static_cast<int>(edges.size()) - 1;
+            }
+
+            long long run(int s, int t)
+            {
+                long long flow = 0;
+                while (bfs(s, t))
+                {
+                    cursor = head;
+                    while (long long pushed = dfs(s, t, INF))
+                        flow += pushed;
+                }
+                return flow;
+            }
+
+        private:
+            struct Edge
+            {
+                int to;
+                int next;
+                long long cap;
+            };
+
+            bool bfs(int s, int t)
+            {
+                std::fill(level.begin(), level.end(), -1);
+                std::queue<int> q;
+                level[s] = 0;
+                q.push(s);
+                while (!q.empty())
+                {
+                    int v = q.front();
+                    q.pop();
+                    for (int e = head[v]; e >= 0; e = edges[e].next)
+                    {
+                        if (edges[e].cap > 0 && level[edges[e].to] < 0)
+                        {
+                            level[edges[e].to] = level[v] + 1;
+                            q.push(edges[e].to);
+                        }
+                    }
+                }
+                return level[t] >= 0;
+            }
+
+            // 沿层次图找一条增广路；网络的层数很深(用户缓冲链)，用显式栈避免递归过深
+            long long dfs(int s, int t, long long limit)
+            {
+                std::vector<int> path; // 路径上的边
+                int v = s;
+                while (true)
+                {
+                    if (v == t)
+                    {
+                        long long pushed = limit;
+                        for (int e : path)
+                            pushed = std::min(pushed, edges[e].cap);
+                        for (int e : path)
+                        {
+                            edges[e].cap -= pushed;
+                            edges[e ^ 1].cap += pushed;
+                        }
+                        return pushed;
+                    }
+                    int &e = cursor[v];
+                    while (e >= 0 && !(edges[e].cap > 0 && level[edges[e].to] == level[v] + 1))
+                        e = edges[e].next;
+                    if (e >= 0)
+                    {
+                        path.push_back(e);
+                        v = edges[e].to;
+                        continue;
+                    }
+                    // v 走不通，退回上一个点并跳过这条边
+                    if (path.empty())
+                        return 0;
+                    level[v] = -1;
+                    int back = path.back();
+                    path.pop_back();
+                    v = edges[back ^ 1].to;
+                    cursor[v] = edges[cursor[v]].next;
+                }
+            }
+
+            std::vector<int> head;
+            std::vector<int> level;
+            std::vector<int> cursor;
+            std::vector<Edge> edges;
+        };
+
+        // 用户用最省显存-时间的batch推理一个样本占用的显存乘毫秒；放不下时为无穷
+        double memory_time_per_sample(const Instance &inst, int user, int server)
+        {
+            const UserSpec &u = inst.users[user];
+            const ServerSpec &sv = inst.servers[server];
+            double best = std::numeric_limits<double>::infinity();
+            for (int B = 1; B <= MAX_BATCH_SIZE && u.a * B + u.b <= sv.m; ++B)
+                best = std::min(best, static_cast<double>(u.a * B + u.b) * inference_time(B, sv.k) / B);
+            return best;
+        }
+
+        // 用户的时间窗按 stretch*(e-s) 放宽后，只在时间窗内推理的最大流
+        long long windowed_flow(const Instance &inst, int bucket, double stretch,
+                                const std::vector<std::vector<double>> &per_sample)
+        {
+            std::vector<long long> window_end(inst.M);
+            long long horizon = 0;
+            for (int i = 0; i < inst.M; ++i)
+            {
+                const UserSpec &u = inst.users[i];
+                window_end[i] = u.e + static_cast<long long>(std::floor(stretch * (u.e - u.s)));
+                horizon = std::max(horizon, window_end[i]);
+            }
+            int buckets = static_cast<int>(horizon / bucket) + 1;
+
+            const int source = 0, sink = 1;
+            MaxFlow flow(2 + inst.N * buckets);
+            auto server_node = [&](int s, int b)
+            { return 2 + s * buckets + b; };
+
+            for (int s = 0; s < inst.N; ++s)
+            {
+                const ServerSpec &sv = inst.servers[s];
+                double min_cost = std::numeric_limits<double>::infinity();
+                for (int i = 0; i < inst.M; ++i)
+                    min_cost = std::min(min_cost, per_sample[i][s]);
+                if (std::isinf(min_cost))
+                    continue;
+                long long cap = static_cast<long long>(std::ceil(static_cast<double>(sv.g) * sv.m * bucket / min_cost));
+                for (int b = 0; b < buckets; ++b)
+                    flow.add_edge(server_node(s, b), sink, cap);
+            }
+
+            for (int i = 0; i < inst.M; ++i)
+            {
+                const UserSpec &u = inst.users[i];
+                int user = flow.add_node();
+                flow.add_edge(source, user, u.cnt);
+
+                // 一个桶内最多能发出的请求数按最小时延计算，每个请求最多带所有服务器中最大的batch
+                int min_latency = std::numeric_limits<int>::max();
+                int max_batch = 0;
+                for (int s = 0; s < inst.N; ++s)
+                {
+                    min_latency = std::min(min_latency, inst.latency[s][i]);
+                    max_batch = std::max(max_batch, std::min(MAX_BATCH_SIZE, (inst.servers[s].m - u.b) / u.a));
+                }
+                long long sends = (bucket - 1) / (min_latency + 1) + 1;
+
+                int first = u.s / bucket;
+                int last = static_cast<int>(window_end[i] / bucket);
+                int prev = -1;
+                for (int b = first; b <= last; ++b)
+                {
+                    int node = flow.add_node();
+                    flow.add_edge(user, node, sends * max_batch);
+                    if (prev >= 0)
+                        flow.add_edge(prev, node, INF);
+                    for (int s = 0; s < inst.N; ++s)
+                    {
+                        if (std::isinf(per_sample[i][s]))
+                            continue;
+                        const ServerSpec &sv = inst.servers[s];
+                        long long cap = static_cast<long long>(std::ceil(static_cast<double>(sv.g) * sv.m * bucket / per_sample[i][s]));
+                        flow.add_edge(node, server_node(s, b), cap);
+                    }
+                    prev = node;
+                }
+            }
+            return flow.run(source, sink);
+        }
+
+    } // namespace
+
+    long long isolated_end(const Instance &inst, int user)
+    {
+        // 请求数至少为 ceil(cnt / 最大batch)，相邻请求至少相隔 最小时延+1，最后一个请求至少再经过时延和1毫秒推理
+        const UserSpec &u = inst.users[user];
+        int min_latency = std::numeric_limits<int>::max();
+        int max_batch = 0;
+        for (int s = 0; s < inst.N; ++s)
+        {
+            min_latency = std::min(min_latency, inst.latency[s][user]);
+            max_batch = std::max(max_batch, std::min(MAX_BATCH_SIZE, (inst.servers[s].m - u.b) / u.a));
+        }
+        long long requests = (u.cnt + max_batch - 1) / max_batch;
+        return u.s + (requests - 1) * (min_latency + 1) + min_latency + 1;
+    }
+
+    FluidBound fluid_bound(const Instance &inst, int bucket)
+    {
+        FluidBound result;
+        std::vector<std::vector<double>> per_sample(inst.M, std::vector<double>(inst.N));
+        for (int i = 0; i < inst.M; ++i)
+        {
+            result.total_samples += inst.users[i].cnt;
+            for (int s = 0; s < inst.N; ++s)
+                per_sample[i][s] = memory_time_per_sample(inst, i, s);
+        }
+
+        result.on_time_flow = windowed_flow(inst, bucket, 0.0, per_sample);
+        long long deficit = result.total_samples - result.on_time_flow;
+
+        // 超时用户的样本数之和不少于缺口，样本多的用户先计入
+        std::vector<int> counts;
+        for (const UserSpec &u : inst.users)
+            counts.push_back(u.cnt);
+        std::sort(counts.rbegin(), counts.rend());
+        for (long long covered = 0; covered < deficit; covered += counts[result.min_late_users++])
+            ;
+
+        if (deficit > 0)
+        {
+            // 二分最小的放宽比例，误差1e-3
+            double lo = 0, hi = 1;
+            while (windowed_flow(inst, bucket, hi, per_sample) < result.total_samples)
+            {
+                lo = hi;
+                hi *= 2;
+            }
+            while (hi - lo > 1e-3)
+            {
+                double mid = (lo + hi) / 2;
+                if (windowed_flow(inst, bucket, mid, per_sample) < result.total_samples)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            result.min_max_lateness = lo;
+        }
+
+        // 各用户不受竞争时的得分项上界 U；超时用户的得分项不超过 min(U, 1)，至少 min_late_users 个用户超时，
+        // 按损失最小的用户计入；其中超时最多的用户得分项不超过 min(U, h(λ))，再扣除所有用户中最小的这部分损失
+        std::vector<double> loss;
+        double worst_loss = std::numeric_limits<double>::infinity();
+        double lateness_cap = h(result.min_max_lateness);
+        for (int i = 0; i < inst.M; ++i)
+        {
+            double term = user_term(inst.users[i], isolated_end(inst, i), 0);
+            result.isolated_terms += term;
+            loss.push_back(std::max(0.0, term - 1));
+            worst_loss = std::min(worst_loss, std::min(term, 1.0) - std::min(term, lateness_cap));
+        }
+        std::sort(loss.begin(), loss.end());
+        double sum = result.isolated_terms;
+        for (int k = 0; k < result.min_late_users; ++k)
+            sum -= loss[k];
+        if (result.min_late_users > 0)
+            sum -= worst_loss;
+        result.score = h(result.min_late_users) * sum * 10000;
+        return result;
+    }
+
+} // namespace sim
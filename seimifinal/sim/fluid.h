@@ -0,0 +1,38 @@
+#pragma once
+
+// 流体松弛上界
+// 把样本看作连续流，忽略请求的整数性、迁移与NPU队列的先后规则，求任何合法方案得分的上界，
+// 用于在大数据上衡量"还剩多少差距"。
+//
+// 时间按 bucket 毫秒分桶，在时间展开网络上求最大流:
+//   源点 -> 用户: 容量 cnt
+//   用户 -> (用户, 桶): 每桶最多发送的请求数 * 最大batch(用户总发送速率，不区分服务器)
+//   (用户, 桶) -> (用户, 下一桶): 无穷(已发送、尚未推理的样本可以等待)
+//   (用户, 桶) -> (服务器, 桶): 该用户独占服务器全部NPU时每桶最多推理的样本数
+//   (服务器, 桶) -> 汇点: 服务器每桶的显存-时间容量 g*m*bucket 除以所有用户中最小的单样本显存-时间
+// 单样本显存-时间为 min_B (a*B+b)*ceil(sqrt(B)/k)/B，即用最省显存-时间的batch推理一个样本占用的显存乘毫秒。
+// 用户只在 [s, e] 覆盖的桶内推理时的最大流若小于总样本数，缺少的样本只能由超时用户承担，
+// 由此得到超时用户数K的下界；把所有用户的时间窗按 λ(e-s) 同比放宽，二分出能推理完全部样本的最小 λ，
+// 即最大超时比例的下界。每个用户不受竞争时的最早完成时刻给出单个用户得分项的上界。
+
+#include "simulator.h"
+
+namespace sim
+{
+
+    struct FluidBound
+    {
+        long long total_samples = 0;
+        long long on_time_flow = 0;  // 只在时间窗内推理时的最大流
+        int min_late_users = 0;      // 超时用户数的下界
+        double min_max_lateness = 0; // 最大超时比例 (end-e)/(e-s) 的下界
+        double isolated_terms = 0;   // 各用户不受竞争时得分项上界之和
+        double score = 0;            // 得分上界
+    };
+
+    // 单个用户不受竞争时最后一个样本完成时刻的下界
+    long long isolated_end(const Instance &inst, int user);
+
+    FluidBound fluid_bound(const Instance &inst, int bucket);
+
+} // namespace sim
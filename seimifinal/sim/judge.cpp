@@ -0,0 +1,47 @@
+// 本地判题器: 用精确模拟器回放调度方案并输出得分明细
+// 用法: ./judge.exe data.in output.out
+
+#include "simulator.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    const char *input_file = argc > 1 ? argv[1] : "data.in";
+    const char *output_file = argc > 2 ? argv[2] : "output.out";
+
+    std::ifstream input(input_file);
+    sim::Instance inst;
+    if (!input || !sim::read_instance(input, inst))
+    {
+        std::fprintf(stderr, "读取输入失败: %s\n", input_file);
+        return 1;
+    }
+
+    std::ifstream output(output_file);
+    sim::Schedule schedule;
+    if (!output || !sim::read_schedule(output, inst, schedule))
+    {
+        std::printf("Invalid Output\n");
+        return 2;
+    }
+
+    sim::SimResult result = sim::simulate(inst, schedule);
+    if (result.verdict != sim::Verdict::Ok)
+    {
+        std::printf("%s (用户%d)\n", sim::verdict_name(result.verdict), result.bad_user + 1);
+        return 2;
+    }
+
+    std::printf("%4s %10s %10s %6s %10s\n", "用户", "要求结束", "实际完成", "迁移", "得分");
+    for (int i = 0; i < inst.M; ++i)
+    {
+        double term = sim::user_term(inst.users[i], result.end[i], result.move[i]) * 10000;
+        std::printf("%4d %10d %10lld %6d %10.1f\n", i + 1, inst.users[i].e, result.end[i], result.move[i], term);
+    }
+    std::printf("超时用户: %d, 全局惩罚: %.4f\n", result.K, sim::h(result.K));
+    std::printf("得分: %.3f\n", result.score);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "scorer.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+    int score_streams(std::istream &input, std::istream &output, lc_score_result *result,
+                      long long *end, int *move, int capacity)
+    {
+        lc_score_result local = {-1, -1, 0, 0, 0.0};
+        sim::Instance inst;
+        if (sim::read_instance(input, inst))
+        {
+            local.M = inst.M;
+            sim::Schedule schedule;
+            sim::SimResult sr;
+            if (!sim::read_schedule(output, inst, schedule))
+                sr.verdict = sim::Verdict::InvalidOutput;
+            else
+                sr = sim::simulate(inst, schedule);
+
+            local.verdict = static_cast<int>(sr.verdict);
+            local.bad_user = sr.bad_user;
+            if (sr.verdict == sim::Verdict::Ok)
+            {
+                local.K = sr.K;
+                local.score = sr.score;
+                int n = std::min(capacity, inst.M);
+                for (int i = 0; i < n; ++i)
+                {
+                    if (end)
+                        end[i] = sr.end[i];
+                    if (move)
+                        move[i] = sr.move[i];
+                }
+            }
+        }
+        if (result)
+            *result = local;
+        return local.verdict;
+    }
+
+} // namespace
+
+extern "C"
+{
+
+    int lc_score_text(const char *input_text, const char *output_text, lc_score_result *result,
+                      long long *end, int *move, int capacity)
+    {
+        std::istringstream input(input_text ? input_text : "");
+        std::istringstream output(output_text ? output_text : "");
+        return score_streams(input, output, result, end, move, capacity);
+    }
+
+    int lc_score_files(const char *input_path, const char *output_path, lc_score_result *result,
+                       long long *end, int *move, int capacity)
+    {
+        std::ifstream input(input_path ? input_path : "");
+        std::ifstream output(output_path ? output_path : "");
+        return score_streams(input, output, result, end, move, capacity);
+    }
+
+    const char *lc_verdict_name(int verdict)
+    {
+        if (verdict < 0)
+            return "Invalid Input";
+        return sim::verdict_name(static_cast<sim::Verdict>(verdict));
+    }
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+/* 精确评分的C接口，编译为 libscorer.so 后供 Python(ctypes) 等调用 */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct
+    {
+        int verdict;  /* 0为合法，其余与 sim::Verdict 的顺序一致；-1表示输入文件无法解析 */
+        int bad_user; /* 首个出错用户(0开始)，合法时为-1 */
+        int M;        /* 用户数量 */
+        int K;        /* 超时用户数 */
+        double score; /* 最终得分 */
+    } lc_score_result;
+
+    /* 对文本形式的输入与输出评分。
+       end / move 可为空；非空时写入前 min(capacity, M) 个用户的 end_i 与 move_i。
+       返回值同 result->verdict。 */
+    int lc_score_text(const char *input_text, const char *output_text, lc_score_result *result,
+                      long long *end, int *move, int capacity);
+
+    /* 同上，参数为文件路径 */
+    int lc_score_files(const char *input_path, const char *output_path, lc_score_result *result,
+                       long long *end, int *move, int capacity);
+
+    /* 错误类型名称，如 "Invalid User Send Time" */
+    const char *lc_verdict_name(int verdict);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,312 @@
+#include "simulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <utility>
+
+namespace sim
+{
+
+    const char *verdict_name(Verdict v)
+    {
+        switch (v)
+        {
+        case Verdict::Ok:
+            return "OK";
+        case Verdict::InvalidOutput:
+            return "Invalid Output";
+        case Verdict::BatchsizeExceedsMemory:
+            return "Batchsize Exceeds Memory";
+        case Verdict::SamplesNotFullyProcessed:
+            return "Samples Not Fully Processed";
+        case Verdict::InvalidTimeOrder:
+            return "Invalid Time Order";
+        case Verdict::InvalidNpuIndex:
+            return "Invalid NPU Index";
+        case Verdict::InvalidUserSendTime:
+            return "Invalid User Send Time";
+        case Verdict::InvalidServerIndex:
+            return "Invalid Server Index";
+        }
+        return "Unknown Error";
+    }
+
+    int inference_time(int B, int k)
+    {
+        if (B <= 0)
+            return 0;
+        // 最小的t满足 t*k >= sqrt(B)，即 (t*k)^2 >= B
+        int t = static_cast<int>(std::sqrt(static_cast<double>(B))) / k;
+        while ((t * k) * (t * k) < B)
+            ++t;
+        while (t > 1 && ((t - 1) * k) * ((t - 1) * k) >= B)
+            --t;
+        return t;
+    }
+
+    bool read_instance(std::istream &in, Instance &inst)
+    {
+        if (!(in >> inst.N) || inst.N <= 0)
+            return false;
+        inst.servers.resize(inst.N);
+        inst.npu_offset.resize(inst.N);
+        inst.total_npus = 0;
+        for (int i = 0; i < inst.N; ++i)
+        {
+            ServerSpec &sv = inst.servers[i];
+            if (!(in >> sv.g >> sv.k >> sv.m))
+                return false;
+            inst.npu_offset[i] = inst.total_npus;
+            inst.total_npus += sv.g;
+        }
+
+        if (!(in >> inst.M) || inst.M <= 0)
+            return false;
+        inst.users.resize(inst.M);
+        for (int i = 0; i < inst.M; ++i)
+        {
+            if (!(in >> inst.users[i].s >> inst.users[i].e >> inst.users[i].cnt))
+                return false;
+        }
+
+        inst.latency.assign(inst.N, std::vector<int>(inst.M));
+        for (int i = 0; i < inst.N; ++i)
+        {
+            for (int j = 0; j < inst.M; ++j)
+            {
+                if (!(in >> inst.latency[i][j]))
+                    return false;
+            }
+        }
+
+        for (int i = 0; i < inst.M; ++i)
+        {
+            if (!(in >> inst.users[i].a >> inst.users[i].b))
+                return false;
+        }
+        return true;
+    }
+
+    bool read_schedule(std::istream &in, const Instance &inst, Schedule &schedule)
+    {
+        schedule.assign(inst.M, {});
+        std::string line;
+        for (int i = 0; i < inst.M; ++i)
+        {
+            int T = 0;
+            if (!std::getline(in, line))
+                return false;
+            std::istringstream head(line);
+            if (!(head >> T) || T < 0)
+                return false;
+
+            if (!std::getline(in, line))
+                return false;
+            std::istringstream body(line);
+            schedule[i].resize(T);
+            for (Request &r : schedule[i])
+            {
+                if (!(body >> r.time >> r.server >> r.npu >> r.B))
+                    return false;
+            }
+            long long extra;
+            if (body >> extra)
+                return false; // 参数比实际多
+        }
+        return true;
+    }
+
+    Verdict validate(const Instance &inst, const Schedule &schedule, int *bad_user)
+    {
+        auto fail = [&](int user, Verdict v)
+        {
+            if (bad_user)
+                *bad_user = user;
+            return v;
+        };
+
+        if (static_cast<int>(schedule.size()) != inst.M)
+            return fail(-1, Verdict::InvalidOutput);
+
+        for (int i = 0; i < inst.M; ++i)
+        {
+            const UserSpec &user = inst.users[i];
+            const std::vector<Request> &reqs = schedule[i];
+            int T = static_cast<int>(reqs.size());
+            if (T < 1 || T > MAX_REQUESTS_PER_USER)
+                return fail(i, Verdict::InvalidOutput);
+            if (reqs[0].time < user.s)
+                return fail(i, Verdict::InvalidUserSendTime);
+
+            long long total = 0;
+            for (int j = 0; j < T; ++j)
+            {
+                const Request &r = reqs[j];
+                if (r.time < 0 || r.time > MAX_SEND_TIME)
+                    return fail(i, Verdict::InvalidOutput);
+                if (r.server < 1 || r.server > inst.N)
+                    return fail(i, Verdict::InvalidServerIndex);
+                const ServerSpec &sv = inst.servers[r.server - 1];
+                if (r.npu < 1 || r.npu > sv.g)
+                    return fail(i, Verdict::InvalidNpuIndex);
+                if (r.B < 1 || r.B > MAX_BATCH_SIZE || user.a * r.B + user.b > sv.m)
+                    return fail(i, Verdict::BatchsizeExceedsMemory);
+                if (j > 0)
+                {
+                    const Request &prev = reqs[j - 1];
+                    if (r.time <= prev.time)
+                        return fail(i, Verdict::InvalidTimeOrder);
+                    // 用户在 x+latency+1 之后才能发送下一个请求
+                    if (r.time < prev.time + inst.latency[prev.server - 1][i] + 1)
+                        return fail(i, Verdict::InvalidUserSendTime);
+                }
+                total += r.B;
+            }
+            if (total != user.cnt)
+                return fail(i, Verdict::SamplesNotFullyProcessed);
+        }
+
+        if (bad_user)
+            *bad_user = -1;
+        return Verdict::Ok;
+    }
+
+    void replay_npu(std::vector<NpuJob> &jobs, int memory)
+    {
+        std::sort(jobs.begin(), jobs.end(), [](const NpuJob &x, const NpuJob &y)
+                  { return x.arrival != y.arrival ? x.arrival < y.arrival : x.user < y.user; });
+        if (jobs.empty())
+            return;
+
+        int min_mem = std::numeric_limits<int>::max();
+        for (const NpuJob &job : jobs)
+            min_mem = std::min(min_mem, job.mem);
+
+        // 正在推理的请求: (完成时刻, 显存)
+        using Running = std::pair<long long, int>;
+        std::priority_queue<Running, std::vector<Running>, std::greater<Running>> running;
+        std::vector<int> waiting; // 队列中尚未开始的请求，保持(到达时刻, 用户编号)有序
+        waiting.reserve(jobs.size());
+
+        const long long INF = std::numeric_limits<long long>::max();
+        size_t next_arrival = 0;
+        int used = 0;
+
+        while (next_arrival < jobs.size() || !waiting.empty())
+        {
+            long long t = next_arrival < jobs.size() ? jobs[next_arrival].arrival : INF;
+            if (!running.empty())
+                t = std::min(t, running.top().first);
+
+            // 1. 移除已完成推理的请求
+            while (!running.empty() && running.top().first <= t)
+            {
+                used -= running.top().second;
+                running.pop();
+            }
+            // 2. 增加当前时刻接收到的请求(到达有序，直接追加即保持队列有序)
+            while (next_arrival < jobs.size() && jobs[next_arrival].arrival <= t)
+                waiting.push_back(static_cast<int>(next_arrival++));
+
+            // 3. 从队首至队尾扫描，放得下的请求本毫秒开始推理
+            size_t kept = 0;
+            size_t w = 0;
+            for (; w < waiting.size() && memory - used >= min_mem; ++w)
+            {
+                NpuJob &job = jobs[waiting[w]];
+                if (used + job.mem <= memory)
+                {
+                    job.start = t;
+                    job.finish = t + job.duration;
+                    used += job.mem;
+                    running.push({job.finish, job.mem});
+                }
+                else
+                {
+                    waiting[kept++] = waiting[w];
+                }
+            }
+            // 剩余显存已放不下任何请求，其余请求原样保留
+            for (; w < waiting.size(); ++w)
+                waiting[kept++] = waiting[w];
+            waiting.resize(kept);
+        }
+    }
+
+    double h(double x)
+    {
+        return std::pow(2.0, -x / 100.0);
+    }
+
+    double p(double x)
+    {
+        return std::pow(2.0, -x / 200.0);
+    }
+
+    double user_term(const UserSpec &user, long long end, int move)
+    {
+        double lateness = static_cast<double>(end - user.e) / (user.e - user.s);
+        return h(lateness) * p(move);
+    }
+
+    SimResult simulate(const Instance &inst, const Schedule &schedule)
+    {
+        SimResult result;
+        result.verdict = validate(inst, schedule, &result.bad_user);
+        if (result.verdict != Verdict::Ok)
+            return result;
+
+        // 按NPU分组
+        std::vector<std::vector<NpuJob>> per_npu(inst.total_npus);
+        for (int i = 0; i < inst.M; ++i)
+        {
+            const UserSpec &user = inst.users[i];
+            for (const Request &r : schedule[i])
+            {
+                int server_idx = r.server - 1;
+                const ServerSpec &sv = inst.servers[server_idx];
+                NpuJob job;
+                job.arrival = r.time + inst.latency[server_idx][i];
+                job.user = i;
+                job.mem = user.a * r.B + user.b;
+                job.duration = inference_time(r.B, sv.k);
+                job.start = job.finish = -1;
+                per_npu[inst.npu_index(server_idx, r.npu - 1)].push_back(job);
+            }
+        }
+
+        result.end.assign(inst.M, 0);
+        result.move.assign(inst.M, 0);
+        for (int n = 0; n < inst.N; ++n)
+        {
+            for (int j = 0; j < inst.servers[n].g; ++j)
+            {
+                std::vector<NpuJob> &jobs = per_npu[inst.npu_index(n, j)];
+                replay_npu(jobs, inst.servers[n].m);
+                for (const NpuJob &job : jobs)
+                    result.end[job.user] = std::max(result.end[job.user], job.finish);
+            }
+        }
+
+        double sum = 0;
+        for (int i = 0; i < inst.M; ++i)
+        {
+            const std::vector<Request> &reqs = schedule[i];
+            for (size_t j = 1; j < reqs.size(); ++j)
+            {
+                if (reqs[j].server != reqs[j - 1].server || reqs[j].npu != reqs[j - 1].npu)
+                    ++result.move[i];
+            }
+            if (result.end[i] > inst.users[i].e)
+                ++result.K;
+            sum += user_term(inst.users[i], result.end[i], result.move[i]);
+        }
+        result.score = h(result.K) * sum * 10000;
+        return result;
+    }
+
+} // namespace sim
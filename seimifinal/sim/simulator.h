@@ -0,0 +1,112 @@
+#pragma once
+
+// 复赛精确模拟器
+// 按题面的NPU队列规则回放一份调度方案，得到每个用户的 end_i、move_i 以及 K 和得分。
+// 每个NPU的队列只与发往它的请求有关，因此各NPU独立回放；回放在事件(到达/完成)之间跳跃，
+// 不逐毫秒推进。
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+
+    const int MAX_BATCH_SIZE = 1000;
+    const int MAX_REQUESTS_PER_USER = 300;
+    const long long MAX_SEND_TIME = 1000000;
+
+    struct ServerSpec
+    {
+        int g; // NPU数量
+        int k; // 推理速度系数
+        int m; // 显存大小
+    };
+
+    struct UserSpec
+    {
+        int s, e; // 推理请求时间段[s, e)
+        int cnt;  // 待推理样本数量
+        int a, b; // 显存参数: Memory = a * batchsize + b
+    };
+
+    struct Instance
+    {
+        int N = 0, M = 0;
+        std::vector<ServerSpec> servers;
+        std::vector<UserSpec> users;
+        std::vector<std::vector<int>> latency; // latency[server_idx][user_idx]
+        std::vector<int> npu_offset;           // 服务器第一个NPU的全局编号 [server_idx]
+        int total_npus = 0;
+
+        int npu_index(int server_idx, int npu_idx) const { return npu_offset[server_idx] + npu_idx; }
+    };
+
+    // 与输出格式一致，server / npu 为1开始的编号
+    struct Request
+    {
+        long long time;
+        int server;
+        int npu;
+        int B;
+    };
+
+    using Schedule = std::vector<std::vector<Request>>; // [user_idx]
+
+    // 与判题器的逻辑错误类型一一对应
+    enum class Verdict
+    {
+        Ok,
+        InvalidOutput,
+        BatchsizeExceedsMemory,
+        SamplesNotFullyProcessed,
+        InvalidTimeOrder,
+        InvalidNpuIndex,
+        InvalidUserSendTime,
+        InvalidServerIndex,
+    };
+
+    const char *verdict_name(Verdict v);
+
+    struct SimResult
+    {
+        Verdict verdict = Verdict::Ok;
+        int bad_user = -1;          // 首个出错用户(0开始)，verdict为Ok时为-1
+        std::vector<long long> end; // 每个用户最后一个样本完成的时刻 [user_idx]
+        std::vector<int> move;      // 每个用户的迁移次数 [user_idx]
+        int K = 0;                  // 超时用户数
+        double score = 0;
+    };
+
+    // 单个NPU上的一个请求，replay_npu 回填 start / finish
+    struct NpuJob
+    {
+        long long arrival; // 到达服务器的时刻
+        int user;          // 用户编号，同时到达时编号小的靠前
+        int mem;           // 显存占用 a*B+b
+        int duration;      // 推理耗时
+        long long start;
+        long long finish;
+    };
+
+    // 推理耗时 ceil(B / (k*sqrt(B))) = ceil(sqrt(B)/k)，整数精确计算
+    int inference_time(int B, int k);
+
+    bool read_instance(std::istream &in, Instance &inst);
+    bool read_schedule(std::istream &in, const Instance &inst, Schedule &schedule);
+
+    // 检查方案是否满足输出约束，不合法时返回首个错误并写入 bad_user
+    Verdict validate(const Instance &inst, const Schedule &schedule, int *bad_user);
+
+    // 按(到达时刻, 用户编号)排序 jobs 后回放单个NPU的队列
+    void replay_npu(std::vector<NpuJob> &jobs, int memory);
+
+    // 单个用户的得分项 h((end-e)/(e-s)) * p(move)，不含全局的 h(K)
+    double user_term(const UserSpec &user, long long end, int move);
+    double h(double x);
+    double p(double x);
+
+    // 校验并回放完整方案
+    SimResult simulate(const Instance &inst, const Schedule &schedule);
+
+} // namespace sim
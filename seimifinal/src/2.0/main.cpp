@@ -7,8 +7,58 @@
 #include <limits>
 #include <queue>
 #include <unordered_map>
+#include <unordered_set>
 #include <random>
 #include <utility>
+#include <tuple>
+#include <cstdint>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <memory_resource>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#ifdef __unix__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <csignal>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+// --- 堆分配统计 ---
+// 以 -DALLOC_STATS 编译时替换全局 operator new，统计决策循环中的堆分配次数(配合 --report 输出)
+#ifdef ALLOC_STATS
+static thread_local long long g_heap_allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    ++g_heap_allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+#endif
 
 // 调试函数
 // void print_matrix(const std::vector<std::vector<int>> &matrix)
@@ -46,30 +96,181 @@ struct Server
     int g;                          // NPU数量
     int k;                          // 推理速度系数
     int m;                          // 显存大小
-    std::vector<int> user_max_b;    // 每个用户在该服务器上的最大batch size [user_idx]
     std::vector<double> efficiency; // 预计算的不同批处理大小的效率 [batch_size]
     int optimal_b_overall;          // 该服务器全局最优的batch size
 };
 
-struct User
+// 用户和NPU按字段分开存放(数组结构体)：决策循环逐用户、逐NPU扫描的热字段各自连续，
+// 输入参数等冷字段不再夹在中间占用缓存行
+struct UserTable
 {
-    int id;
-    int s, e;                  // 用户推理请求时间段[s, e)
-    int cnt;                   // 待推理样本数量
-    int remaining_cnt;         // 剩余待推理样本数量
-    long long next_send_time;  // 下一个请求发送时间
-    int last_server_id;        // 上一个请求发送的服务器id
-    int last_npu_id_in_server; // 上一个请求发送的NPU id
-    int a, b;                  // 用户特定的显存参数: Memory = a_i * batchsize + b_i
-    double urgency;            // 紧急度 = remaining_cnt / (deadline - current_time)
+    // 热字段
+    std::vector<int> remaining_cnt;        // 剩余待推理样本数量
+    std::vector<long long> next_send_time; // 下一个请求发送时间
+    std::vector<double> urgency;           // 紧急度 = remaining_cnt / (deadline - current_time)
+    std::vector<int> last_npu;             // 上一个请求发送的NPU(npus下标)，-1表示尚未发送
+    std::vector<int> last_server_idx;      // 上一个请求发送的服务器下标，-1表示尚未发送
+    // 冷字段
+    std::vector<int> s, e; // 用户推理请求时间段[s, e)
+    std::vector<int> cnt;  // 待推理样本数量
+    std::vector<int> a, b; // 用户特定的显存参数: Memory = a_i * batchsize + b_i
+
+    void resize(int n)
+    {
+        remaining_cnt.assign(n, 0);
+        next_send_time.assign(n, 0);
+        urgency.assign(n, 0.0);
+        last_npu.assign(n, -1);
+        last_server_idx.assign(n, -1);
+        s.assign(n, 0);
+        e.assign(n, 0);
+        cnt.assign(n, 0);
+        a.assign(n, 0);
+        b.assign(n, 0);
+    }
+};
+
+// NPU显存占用时间线
+// 题面的NPU每毫秒让队列中所有放得下显存的请求同时推理，原来的 free_at 把NPU当作独占资源，
+// 一个请求推理时显存大多空闲，用户也因此被过度分散到多个NPU。这里按时间记录每个NPU已占用的显存，
+// 新请求在到达后第一个使 [t, t+推理耗时) 内都放得下显存的时刻 t 开始。
+// 每个NPU一棵动态开点线段树，覆盖 [0, TIME_SPAN)，支持区间加和区间最大值。节点的 max 已含本节点的 add，
+// add 不下推(标记永久化)，查询时沿路径累加。所有NPU共用一个节点池，重新调度时清空节点池即可。
+class MemoryTimeline
+{
+public:
+    static const int TIME_SPAN = 1 << 21; // 覆盖发送时刻上限1e6及之后的排队与推理
+
+    void init(size_t npu_count)
+    {
+        roots.assign(npu_count, -1);
+        nodes.clear();
+    }
+
+    void reset()
+    {
+        std::fill(roots.begin(), roots.end(), -1);
+        nodes.clear();
+    }
+
+    // NPU j 上到达时刻 arrival 之后，第一个使 [t, t+duration) 内已占用显存加 memory 不超过 capacity 的时刻 t
+    long long earliest_start(int j, long long arrival, int duration, int memory, int capacity) const
+    {
+        int limit = capacity - memory;
+        long long t = arrival;
+        while (t + duration <= TIME_SPAN)
+        {
+            int blocked = last_above(roots[j], 0, TIME_SPAN, static_cast<int>(t), static_cast<int>(t + duration), limit, 0);
+            if (blocked < 0)
+                break;
+            t = blocked + 1; // 跳过窗口内最后一个放不下的时刻
+        }
+        return t;
+    }
+
+    // NPU j 在 [l, r) 内已占用显存的最大值
+    int max_occupancy(int j, long long l, long long r) const
+    {
+        r = std::min<long long>(r, TIME_SPAN);
+        return l < r ? query_max(roots[j], 0, TIME_SPAN, static_cast<int>(l), static_cast<int>(r)) : 0;
+    }
+
+    // NPU j 在 [start, finish) 内占用 memory，memory 为负时撤销之前计入的占用
+    void occupy(int j, long long start, long long finish, int memory)
+    {
+        finish = std::min<long long>(finish, TIME_SPAN);
+        if (start < finish)
+            roots[j] = add(roots[j], 0, TIME_SPAN, static_cast<int>(start), static_cast<int>(finish), memory);
+    }
+
+private:
+    struct Node
+    {
+        int max;   // 子树内的最大占用(含本节点的 add，不含祖先的 add)
+        int add;   // 整个区间共同的占用
+        int left;  // 子节点在节点池中的下标，-1表示全为0
+        int right;
+    };
+
+    int max_of(int node) const { return node < 0 ? 0 : nodes[node].max; }
+
+    int add(int node, int lo, int hi, int l, int r, int value)
+    {
+        if (node < 0)
+        {
+            node = static_cast<int>(nodes.size());
+            nodes.push_back({0, 0, -1, -1});
+        }
+        if (l <= lo && hi <= r)
+        {
+            nodes[node].add += value;
+            nodes[node].max += value;
+            return node;
+        }
+        int mid = lo + (hi - lo) / 2;
+        if (l < mid)
+        {
+            int child = add(nodes[node].left, lo, mid, l, r, value);
+            nodes[node].left = child;
+        }
+        if (r > mid)
+        {
+            int child = add(nodes[node].right, mid, hi, l, r, value);
+            nodes[node].right = child;
+        }
+        nodes[node].max = nodes[node].add + std::max(max_of(nodes[node].left), max_of(nodes[node].right));
+        return node;
+    }
+
+    int query_max(int node, int lo, int hi, int l, int r) const
+    {
+        if (node < 0 || r <= lo || hi <= l)
+            return 0;
+        if (l <= lo && hi <= r)
+            return nodes[node].max;
+        int mid = lo + (hi - lo) / 2;
+        return nodes[node].add + std::max(query_max(nodes[node].left, lo, mid, l, r), query_max(nodes[node].right, mid, hi, l, r));
+    }
+
+    // [l, r) 与 [lo, hi) 的交集中占用超过 limit 的最右时刻，没有时返回-1；carry 为祖先的 add 之和
+    int last_above(int node, int lo, int hi, int l, int r, int limit, int carry) const
+    {
+        if (r <= lo || hi <= l)
+            return -1;
+        if (node < 0)
+            return carry > limit ? std::min(r, hi) - 1 : -1;
+        if (carry + nodes[node].max <= limit)
+            return -1;
+        if (hi - lo == 1)
+            return lo;
+        carry += nodes[node].add;
+        int mid = lo + (hi - lo) / 2;
+        int found = last_above(nodes[node].right, mid, hi, l, r, limit, carry);
+        return found >= 0 ? found : last_above(nodes[node].left, lo, mid, l, r, limit, carry);
+    }
+
+    std::vector<int> roots; // [npu_idx]
+    std::vector<Node> nodes;
 };
 
-struct Npu
+struct NpuTable
 {
-    int server_id;              // 服务器id
-    int id_in_server;           // NPU id
-    long long free_at;          // 空闲时间
-    long long utilization_time; // NPU累计工作时长，用于负载均衡
+    std::vector<int> server_idx;             // 所属服务器下标(0开始)
+    std::vector<int> id_in_server;           // NPU id
+    MemoryTimeline timeline;                 // 显存占用时间线
+    std::vector<long long> busy_until;       // 最后一个已调度请求的完成时刻，只用于死循环时推进时间
+    std::vector<long long> utilization_time; // NPU累计工作时长，用于负载均衡
+
+    size_t size() const { return server_idx.size(); }
+
+    void add(int server, int id)
+    {
+        server_idx.push_back(server);
+        id_in_server.push_back(id);
+        busy_until.push_back(0);
+        utilization_time.push_back(0);
+        timeline.init(server_idx.size());
+    }
 };
 
 struct ScheduledRequest
@@ -84,24 +285,69 @@ struct ScheduledRequest
 // --- 全局状态 ---
 int N, M;
 std::vector<Server> servers;
-std::vector<User> users;
-std::vector<std::vector<int>> latencies; // latencies[server_idx][user_idx]
-std::vector<Npu> npus;
+// users / npus 中的热字段在调度过程中被修改，多起点并行时每个线程各持一份
+thread_local UserTable users;
+thread_local NpuTable npus;
+std::vector<uint8_t> user_latency; // 通信时延 [user_idx * N + server_idx]，取值10..20
+std::vector<int16_t> user_max_b;   // 用户在服务器上的最大batch size [user_idx * N + server_idx]
+std::vector<int> server_npu_offset; // 服务器第一个NPU在npus中的下标 [server_idx]
 const int MAX_BATCH_SIZE = 1000; // 最大批处理大小
 // 成本函数中的权重系数，用于调优
 const long long DEADLINE_PENALTY_WEIGHT = 1000;
 const int MIGRATION_PENALTY = 70;
 const int LOAD_BALANCE_WEIGHT = 1;
 const double SOFTMAX_TEMPERATURE = 0.0000001; // softmax温度参数，控制概率分布的锐度
+const long long COLOCATION_PENALTY = 100000;  // 不发往共置规划指定的NPU时的成本惩罚，远大于其他各项，指定的NPU可行时总是优先
+std::vector<int> home_npu; // 共置规划给每个用户指定的NPU(npus下标)，-1或为空表示不指定 [user_idx]
+
+inline int latency_of(int server_idx, int user_idx)
+{
+    return user_latency[user_idx * N + server_idx];
+}
+
+// 服务器下标(0开始)和NPU id(1开始)对应的npus下标
+inline int npu_index_of(int server_idx, int npu_id)
+{
+    return server_npu_offset[server_idx] + npu_id - 1;
+}
+
+inline int max_batch_of(int server_idx, int user_idx)
+{
+    return user_max_b[user_idx * N + server_idx];
+}
+
+// --- 推理耗时表 ---
+// k取值1..5、B取值1..1000，推理耗时 ceil(B / (k*sqrt(B))) = ceil(sqrt(B)/k) 的全部取值在编译期用整数算出:
+// 最小的t满足 (t*k)^2 >= B。决策循环中不再有浮点 sqrt/ceil，各版本的结果也可逐位复现。
+const int MAX_SPEED_COEF = 5;
+using InferenceTimeTable = std::array<std::array<int16_t, MAX_BATCH_SIZE + 1>, MAX_SPEED_COEF + 1>;
+
+constexpr InferenceTimeTable make_inference_time_table()
+{
+    InferenceTimeTable table{};
+    for (int k = 1; k <= MAX_SPEED_COEF; ++k)
+    {
+        int t = 0;
+        for (int B = 1; B <= MAX_BATCH_SIZE; ++B)
+        {
+            while ((t * k) * (t * k) < B)
+                ++t;
+            table[k][B] = static_cast<int16_t>(t);
+        }
+    }
+    return table;
+}
+
+constexpr InferenceTimeTable INFERENCE_TIME = make_inference_time_table();
 
 // --- 辅助函数 ---
 
 // 计算推理耗时
-double calculate_inference_time(int B, int k)
+inline int calculate_inference_time(int B, int k)
 {
     if (B <= 0)
         return 0;
-    return std::ceil(B / (k * std::sqrt(B)));
+    return INFERENCE_TIME[k][B];
 }
 
 // 计算推理效率
@@ -109,10 +355,13 @@ double calculate_efficiency(int B, int k)
 {
     if (B <= 0)
         return 0;
-    double inference_time = calculate_inference_time(B, k);
-    if (inference_time < 1)
-        return B;
-    return B / inference_time;
+    return static_cast<double>(B) / calculate_inference_time(B, k);
+}
+
+// 效率奖励 efficiency * 10 取整，用整数除法精确计算
+inline long long efficiency_bonus(int B, int k)
+{
+    return 10LL * B / calculate_inference_time(B, k);
 }
 
 // 计算用户在服务器上的最大batch
@@ -123,6 +372,76 @@ int calculate_max_batch(int server_m, int user_a, int user_b)
     return std::min(MAX_BATCH_SIZE, (server_m - user_b) / user_a);
 }
 
+// --- Batch大小查询表 ---
+// 推理耗时是B的阶梯函数(断点在(t*k)^2)，效率 B/time 只由k决定。对每个k在编译期把效率表预处理成稀疏表，
+// 任意区间 [lo, hi] 内效率最高(并列时取最小B，与逐个扫描的结果一致)的batch可 O(1) 查询。
+// 效率比较用整数交叉相乘 B1*t2 > B2*t1，不经过浮点。
+template <int K>
+class BatchOracle
+{
+public:
+    // [lo, hi] 内效率最高的batch，要求 1 <= lo <= hi <= MAX_BATCH_SIZE
+    static int best(int lo, int hi)
+    {
+        int j = LOG2_FLOOR[hi - lo + 1];
+        return pick(TABLE[j][lo], TABLE[j][hi - (1 << j) + 1]);
+    }
+
+private:
+    static constexpr int LEVELS = 10; // 2^9 <= 1000 < 2^10
+    using Table = std::array<std::array<int16_t, MAX_BATCH_SIZE + 1>, LEVELS>;
+    using LogTable = std::array<int8_t, MAX_BATCH_SIZE + 2>;
+
+    // 左侧区间的候选编号更小，效率相等时保留左侧
+    static constexpr int pick(int left, int right)
+    {
+        return right * INFERENCE_TIME[K][left] > left * INFERENCE_TIME[K][right] ? right : left;
+    }
+
+    static constexpr Table build()
+    {
+        Table table{};
+        for (int b = 1; b <= MAX_BATCH_SIZE; ++b)
+            table[0][b] = static_cast<int16_t>(b);
+        for (int j = 1; j < LEVELS; ++j)
+        {
+            int half = 1 << (j - 1);
+            for (int b = 1; b + (1 << j) - 1 <= MAX_BATCH_SIZE; ++b)
+                table[j][b] = static_cast<int16_t>(pick(table[j - 1][b], table[j - 1][b + half]));
+        }
+        return table;
+    }
+
+    static constexpr LogTable build_log()
+    {
+        LogTable log{};
+        for (int len = 2; len <= MAX_BATCH_SIZE + 1; ++len)
+            log[len] = static_cast<int8_t>(log[len / 2] + 1);
+        return log;
+    }
+
+    static constexpr Table TABLE = build();           // TABLE[j][b]: [b, b + 2^j) 内的最优batch
+    static constexpr LogTable LOG2_FLOOR = build_log();
+};
+
+// 按服务器的k分派到对应的特化
+inline int best_batch_in_range(int k, int lo, int hi)
+{
+    switch (k)
+    {
+    case 1:
+        return BatchOracle<1>::best(lo, hi);
+    case 2:
+        return BatchOracle<2>::best(lo, hi);
+    case 3:
+        return BatchOracle<3>::best(lo, hi);
+    case 4:
+        return BatchOracle<4>::best(lo, hi);
+    default:
+        return BatchOracle<5>::best(lo, hi);
+    }
+}
+
 // 预计算服务器效率和最佳Batch
 void precalculate_server_stats(Server &server)
 {
@@ -151,18 +470,80 @@ int find_optimal_batch(const Server &server, int max_batch_for_user, int remaini
         return 0;
     }
 
-    // 在 [min_b_required, search_limit] 范围内搜索最优B
-    double best_efficiency = -1.0;
-    int best_b = 0;
-    for (int b = min_b_required; b <= search_limit; ++b)
+    // 在 [min_b_required, search_limit] 范围内查询最优B
+    return best_batch_in_range(server.k, std::max(1, min_b_required), search_limit);
+}
+
+// 并发感知的batch选择
+// NPU同时推理所有放得下显存的请求，每个请求都要付固定的 b 显存。efficiency / find_optimal_batch 只看单个请求的
+// B / time，NPU空闲时沿用；同时驻留的请求占着显存、效率最高的batch要排队时，改为在空闲显存 free_memory 内
+// 选 floor(free_memory/(a*B+b)) * B / time (NPU每毫秒推理的样本数) 最大的batch，并列时取较大的B，一个也放不下时返回0。
+// 同时放得下的请求数和推理耗时都不变的区间内该值随B增大，只需比较两者各自阶梯的右端点与 hi
+int find_packed_batch(const Server &server, int a, int b, int free_memory, int lo, int hi)
+{
+    int best = 0;
+    long long best_num = 0, best_den = 1;
+    auto consider = [&](int B)
     {
-        if (server.efficiency[b] > best_efficiency)
+        if (B < lo || B > hi)
+            return;
+        long long copies = free_memory / (a * B + b);
+        if (copies <= 0)
+            return;
+        long long num = copies * B, den = calculate_inference_time(B, server.k);
+        if (num * best_den > best_num * den || (num * best_den == best_num * den && B > best))
         {
-            best_efficiency = server.efficiency[b];
-            best_b = b;
+            best = B;
+            best_num = num;
+            best_den = den;
+        }
+    };
+    consider(hi);
+    for (int t = 1; (t * server.k) * (t * server.k) < hi; ++t)
+        consider((t * server.k) * (t * server.k));
+    if (a > 0)
+    {
+        for (int n = 1; n * b < free_memory; ++n)
+            consider((free_memory / n - b) / a);
+    }
+    return best;
+}
+
+// 流水线batch选择
+// 用户每 cadence 毫秒发一个请求，同时在推理的请求数为 ceil(推理耗时/cadence)，显存放得下时发送速率 B/cadence 即推理速率，
+// 放不下时受显存限制为 npu_count * floor(m/(a*B+b)) * B / 推理耗时(请求轮流发往 npu_count 个NPU)。
+// 在 [lo, hi] 中选两者较小值最大的B，并列时取较大的B，hi < lo 或一个也放不下时返回0。
+// 与 find_packed_batch 相同，放得下的请求数和推理耗时都不变的区间内速率随B增大，只需比较两者各自阶梯的右端点与 hi
+int find_pipelined_batch(const Server &server, int a, int b, int cadence, int lo, int hi, int npu_count)
+{
+    lo = std::max(1, lo);
+    int best = 0;
+    long long best_num = 0, best_den = 1;
+    auto consider = [&](int B)
+    {
+        if (B < lo || B > hi)
+            return;
+        long long copies = static_cast<long long>(server.m / (a * B + b)) * npu_count;
+        if (copies <= 0)
+            return;
+        // 速率 = B / max(cadence, 推理耗时/copies)
+        long long num = copies * B, den = std::max<long long>(cadence * copies, calculate_inference_time(B, server.k));
+        if (num * best_den > best_num * den || (num * best_den == best_num * den && B > best))
+        {
+            best = B;
+            best_num = num;
+            best_den = den;
         }
+    };
+    consider(hi);
+    for (int t = 1; (t * server.k) * (t * server.k) < hi; ++t)
+        consider((t * server.k) * (t * server.k));
+    if (a > 0)
+    {
+        for (int n = 1; server.m / n - b >= a * lo; ++n)
+            consider((server.m / n - b) / a);
     }
-    return best_b;
+    return best;
 }
 
 // 智能Batch选择 - 考虑时间窗口和效率平衡
@@ -187,17 +568,7 @@ int find_optimal_batch_smart(const Server &server, int max_batch_for_user, int r
     }
 
     // 正常情况下，寻找效率最优的batch
-    double best_efficiency = -1.0;
-    int best_b = 0;
-    for (int b = min_b_required; b <= search_limit; ++b)
-    {
-        if (server.efficiency[b] > best_efficiency)
-        {
-            best_efficiency = server.efficiency[b];
-            best_b = b;
-        }
-    }
-    return best_b;
+    return best_batch_in_range(server.k, std::max(1, min_b_required), search_limit);
 }
 
 void read_input()
@@ -218,415 +589,3935 @@ void read_input()
     users.resize(M);
     for (int i = 0; i < M; ++i)
     {
-        users[i].id = i + 1;
-        std::cin >> users[i].s >> users[i].e >> users[i].cnt;
-        users[i].remaining_cnt = users[i].cnt;
-        users[i].next_send_time = users[i].s;
-        users[i].last_server_id = -1;
-        users[i].last_npu_id_in_server = -1;
+        std::cin >> users.s[i] >> users.e[i] >> users.cnt[i];
+        users.remaining_cnt[i] = users.cnt[i];
+        users.next_send_time[i] = users.s[i];
     }
 
-    latencies.resize(N, std::vector<int>(M));
+    // 输入按服务器逐行给出，转存为按用户连续的一维表
+    user_latency.resize(static_cast<size_t>(M) * N);
     for (int i = 0; i < N; ++i)
     {
         for (int j = 0; j < M; ++j)
         {
-            std::cin >> latencies[i][j];
+            int latency;
+            std::cin >> latency;
+            user_latency[j * N + i] = static_cast<uint8_t>(latency);
         }
     }
 
     for (int i = 0; i < M; ++i)
     {
-        std::cin >> users[i].a >> users[i].b;
+        std::cin >> users.a[i] >> users.b[i];
     }
 
-    for (int i = 0; i < N; ++i)
+    user_max_b.resize(static_cast<size_t>(M) * N);
+    for (int j = 0; j < M; ++j)
     {
-        servers[i].user_max_b.resize(M);
-        for (int j = 0; j < M; ++j)
+        for (int i = 0; i < N; ++i)
         {
-            servers[i].user_max_b[j] = calculate_max_batch(servers[i].m, users[j].a, users[j].b);
+            user_max_b[j * N + i] = static_cast<int16_t>(calculate_max_batch(servers[i].m, users.a[j], users.b[j]));
         }
     }
 
+    server_npu_offset.resize(N);
     for (int i = 0; i < N; ++i)
     {
+        server_npu_offset[i] = static_cast<int>(npus.size());
         for (int j = 0; j < servers[i].g; ++j)
         {
-            npus.push_back({servers[i].id, j + 1, 0, 0});
+            npus.add(i, j + 1);
         }
     }
 }
 
-// 更新用户紧急度
-void update_user_urgency(long long current_time)
+// 更新就绪用户的紧急度
+template <typename Container>
+void update_user_urgency(long long current_time, const Container &ready_users)
 {
-    for (int i = 0; i < M; ++i)
+    for (int i : ready_users)
     {
-        if (users[i].remaining_cnt <= 0)
+        if (users.remaining_cnt[i] <= 0)
         {
-            users[i].urgency = 0;
+            users.urgency[i] = 0;
             continue;
         }
-        long long remaining_time = std::max(1LL, users[i].e - current_time);
-        users[i].urgency = static_cast<double>(users[i].remaining_cnt) / remaining_time;
+        long long remaining_time = std::max(1LL, users.e[i] - current_time);
+        users.urgency[i] = static_cast<double>(users.remaining_cnt[i]) / remaining_time;
     }
 }
 
-// --- 主调度逻辑 ---
+// --- 精确评估器 ---
+// 按题面的NPU队列规则(与 sim/simulator.cpp 同一模型)维护每个NPU上的请求队列:
+// 每次有请求到达或完成时，移除已完成请求、加入新到达请求，再按(到达时刻, 用户编号)从队首扫描，
+// 放得下显存的请求立即开始推理。
+// 支持试探性地插入、删除、修改单个请求：只重放受影响的NPU，只刷新完成时刻发生变化的用户，
+// 撤销时按日志逆序恢复被改动的字段，不需要重新模拟。
+// 一组请求到达时若NPU上既无推理中也无等待的请求(空闲点)，之后的结果只取决于此后到达的请求，
+// 因此重放只需从改动之前最近的空闲点开始，到改动之后新旧两次回放都经过的空闲点为止。
 
-int main()
+class IncrementalEvaluator
 {
-    read_input();
-
-    std::vector<std::vector<ScheduledRequest>> solution(M);
-    long long total_remaining_cnt = 0;
-    for (const auto &user : users)
+public:
+    // 由完整方案构建评估器，请求句柄按用户、按发送顺序依次编号
+    void build(const std::vector<std::vector<ScheduledRequest>> &solution)
     {
-        total_remaining_cnt += user.cnt;
-    }
+        npu_offset.assign(N, 0);
+        for (size_t j = 0; j < npus.size(); ++j)
+        {
+            if (npus.id_in_server[j] == 1)
+                npu_offset[npus.server_idx[j]] = static_cast<int>(j);
+        }
+
+        reqs.clear();
+        free_handles.clear();
+        npu_jobs.assign(npus.size(), {});
+        user_reqs.assign(M, {});
+        user_end.assign(M, 0);
+        user_move.assign(M, 0);
+        user_term.assign(M, 0.0);
+        user_dirty.assign(M, 0);
+        npu_dirty.assign(npus.size(), 0);
+        dirty_lo.assign(npus.size(), 0);
+        dirty_hi.assign(npus.size(), 0);
+        journal.clear();
 
-    // 修复变量遮蔽问题 - 移除重复声明
-    while (total_remaining_cnt > 0)
-    {
-        long long current_time = std::numeric_limits<long long>::max();
         for (int i = 0; i < M; ++i)
         {
-            if (users[i].remaining_cnt > 0)
+            for (const ScheduledRequest &r : solution[i])
             {
-                current_time = std::min(current_time, users[i].next_send_time);
+                int h = static_cast<int>(reqs.size());
+                reqs.push_back(make_req(i, r.time, npu_index(r.server_id, r.npu_id_in_server), r.B));
+                npu_jobs[reqs[h].npu].push_back(h);
+                user_reqs[i].push_back(h);
             }
         }
-        if (current_time == std::numeric_limits<long long>::max())
+        for (size_t n = 0; n < npus.size(); ++n)
         {
-            break; // 所有用户处理完毕
+            std::sort(npu_jobs[n].begin(), npu_jobs[n].end(), [this](int x, int y)
+                      { return queue_before(x, y); });
+            replay(static_cast<int>(n), std::numeric_limits<long long>::min(), std::numeric_limits<long long>::max());
         }
 
-        // 更新用户紧急度
-        update_user_urgency(current_time);
-
-        // 按紧急度对用户排序，优先处理紧急的用户
-        std::vector<int> user_indices;
+        late_count = 0;
+        term_sum = 0;
         for (int i = 0; i < M; ++i)
         {
-            if (users[i].remaining_cnt > 0 && users[i].next_send_time <= current_time)
-            {
-                user_indices.push_back(i);
-            }
+            refresh_user(i);
+            user_dirty[i] = 0;
         }
+        journal.clear();
+    }
 
-        std::sort(user_indices.begin(), user_indices.end(), [](int a, int b)
-                  {
-                      return users[a].urgency > users[b].urgency; // 紧急度高的优先
-                  });
+    // 试探性插入一个请求，返回其句柄
+    int insert(const ScheduledRequest &r)
+    {
+        int user = r.user_id - 1;
+        int h;
+        if (!free_handles.empty())
+        {
+            h = free_handles.back();
+            free_handles.pop_back();
+            log_handle(h, true);
+        }
+        else
+        {
+            h = static_cast<int>(reqs.size());
+            reqs.push_back(Req());
+            log_handle(h, false);
+        }
+        reqs[h] = make_req(user, r.time, npu_index(r.server_id, r.npu_id_in_server), r.B);
+        attach(h);
+        flush();
+        return h;
+    }
 
-        // --- 在current_time进行调度决策 ---
-        long long best_cost = std::numeric_limits<long long>::max();
-        int best_user_idx = -1;
-        int best_npu_idx = -1;
-        int best_B = -1;
-        long long best_finish_time = -1;
+    void remove(int h)
+    {
+        detach(h);
+        log_field(h);
+        reqs[h].alive = false;
+        free_handles.push_back(h);
+        journal.push_back({Op::ReleaseHandle, h, 0, 0, 0.0});
+        flush();
+    }
 
-        std::vector<std::vector<CostInfo>>
-            cost_matrix(M, std::vector<CostInfo>(npus.size()));
+    // 修改请求的发送时刻、目标NPU(npus下标)和batch大小
+    void update(int h, long long time, int npu, int B)
+    {
+        detach(h);
+        log_field(h);
+        reqs[h] = make_req(reqs[h].user, time, npu, B);
+        attach(h);
+        flush();
+    }
 
-        // 遍历按紧急度排序的用户
-        for (int i : user_indices)
-        {
+    void retime(int h, long long time)
+    {
+        update(h, time, reqs[h].npu, reqs[h].B);
+    }
 
-            // 计算满足T_i <= 300约束的最小B
-            int requests_so_far = solution[i].size();
-            int remaining_requests_allowed = 300 - requests_so_far;
-            int min_b_required = 1;
-            if (remaining_requests_allowed > 0)
-            {
-                min_b_required = static_cast<int>(std::ceil(static_cast<double>(users[i].remaining_cnt) / remaining_requests_allowed));
-            }
-            else if (users[i].remaining_cnt > 0)
+    // 接受自上次commit以来的全部改动
+    void commit()
+    {
+        journal.clear();
+        saved_reqs.clear();
+    }
+
+    // 撤销自上次commit以来的全部改动
+    void rollback()
+    {
+        for (size_t idx = journal.size(); idx-- > 0;)
+        {
+            const Entry &en = journal[idx];
+            switch (en.op)
             {
-                // 请求次数已达上限，必须一次性发完所有剩余样本
-                min_b_required = users[i].remaining_cnt;
+            case Op::Field:
+                reqs[en.a] = saved_reqs[en.b];
+                break;
+            case Op::Finish:
+                reqs[en.a].finish = en.c;
+                reqs[en.a].idle = en.b != 0;
+                break;
+            case Op::NpuInsert:
+                npu_jobs[en.a].erase(npu_jobs[en.a].begin() + en.b);
+                break;
+            case Op::NpuErase:
+                npu_jobs[en.a].insert(npu_jobs[en.a].begin() + en.b, static_cast<int>(en.c));
+                break;
+            case Op::UserInsert:
+                user_reqs[en.a].erase(user_reqs[en.a].begin() + en.b);
+                break;
+            case Op::UserErase:
+                user_reqs[en.a].insert(user_reqs[en.a].begin() + en.b, static_cast<int>(en.c));
+                break;
+            case Op::UserState:
+                user_end[en.a] = en.c;
+                user_move[en.a] = en.b;
+                user_term[en.a] = en.term;
+                break;
+            case Op::Aggregate:
+                late_count = en.a;
+                term_sum = en.term;
+                break;
+            case Op::NewHandle:
+                reqs.pop_back();
+                break;
+            case Op::ReuseHandle:
+                reqs[en.a].alive = false;
+                free_handles.push_back(en.a);
+                break;
+            case Op::ReleaseHandle:
+                free_handles.pop_back();
+                break;
             }
+        }
+        journal.clear();
+        saved_reqs.clear();
+    }
 
-            // 遍历所有NPU，为该用户寻找最佳调度方案
-            for (size_t j = 0; j < npus.size(); ++j)
-            {
-                int server_idx = npus[j].server_id - 1;
-                int max_b = servers[server_idx].user_max_b[i];
-                if (max_b <= 0)
-                    continue;
+    double score() const
+    {
+        return std::pow(2.0, -late_count / 100.0) * term_sum * 10000;
+    }
 
-                int optimal_B = find_optimal_batch(servers[server_idx], max_b, users[i].remaining_cnt, min_b_required);
-                if (optimal_B <= 0)
-                {
-                    cost_matrix[i][j].cost = std::numeric_limits<long long>::max();
-                    continue; // 无法满足请求
-                }
+    int late_users() const { return late_count; }
+    long long end_of(int user) const { return user_end[user]; }
+    int moves_of(int user) const { return user_move[user]; }
+    long long finish_of(int h) const { return reqs[h].finish; }
+    long long time_of(int h) const { return reqs[h].time; }
+    int npu_of(int h) const { return reqs[h].npu; }
+    int batch_of(int h) const { return reqs[h].B; }
+    const std::vector<int> &requests_of(int user) const { return user_reqs[user]; }
+    const std::vector<int> &jobs_on(int npu) const { return npu_jobs[npu]; }
 
-                long long send_time = users[i].next_send_time;
-                long long arrival_time = send_time + latencies[server_idx][i];
-                long long start_time = std::max(arrival_time, npus[j].free_at);
-                long long inference_time = static_cast<long long>(calculate_inference_time(optimal_B, servers[server_idx].k));
-                long long finish_time = start_time + inference_time;
-                cost_matrix[i][j].finish_time = finish_time; // 记录完成时间
+    ScheduledRequest request(int h) const
+    {
+        const Req &r = reqs[h];
+        return {r.user + 1, r.time, npus.server_idx[r.npu] + 1, npus.id_in_server[r.npu], r.B};
+    }
 
-                // 改进的成本函数 - 考虑更多因素
-                long long time_over_deadline = std::max(0LL, finish_time - users[i].e);
-                long long cost = finish_time;
+    int npu_index(int server_id, int npu_id_in_server) const
+    {
+        return npu_offset[server_id - 1] + npu_id_in_server - 1;
+    }
 
-                // 1. 截止时间惩罚 (非线性)
-                if (time_over_deadline > 0)
-                {
-                    cost += time_over_deadline * time_over_deadline / 1000 + time_over_deadline * DEADLINE_PENALTY_WEIGHT;
-                }
+    // 用户当前的请求序列是否满足输出约束(请求数、发送间隔、样本总数)
+    bool user_feasible(int user) const
+    {
+        const std::vector<int> &list = user_reqs[user];
+        if (list.empty() || list.size() > 300 || reqs[list[0]].time < users.s[user])
+            return false;
+        int total = 0;
+        for (size_t j = 0; j < list.size(); ++j)
+        {
+            const Req &r = reqs[list[j]];
+            if (j > 0)
+            {
+                const Req &prev = reqs[list[j - 1]];
+                if (r.time < prev.time + latency_of(npus.server_idx[prev.npu], user) + 1)
+                    return false;
+            }
+            total += r.B;
+        }
+        return total == users.cnt[user];
+    }
 
-                // 2. 紧急度因子
-                long long remaining_time = std::max(1LL, users[i].e - current_time);
-                if (remaining_time < 10000)
-                { // 时间紧张时
-                    cost = static_cast<long long>(cost * (1.0 + users[i].urgency * 0.1));
-                }
+    std::vector<std::vector<ScheduledRequest>> solution() const
+    {
+        std::vector<std::vector<ScheduledRequest>> result(M);
+        for (int i = 0; i < M; ++i)
+        {
+            for (int h : user_reqs[i])
+                result[i].push_back(request(h));
+        }
+        return result;
+    }
 
-                // 3. 效率奖励 - 选择高效batch的奖励
-                double efficiency_bonus = servers[server_idx].efficiency[optimal_B] * 10;
-                cost -= static_cast<long long>(efficiency_bonus);
+private:
+    struct Req
+    {
+        int user;
+        long long time;    // 发送时刻
+        int npu;           // npus下标
+        int B;
+        long long arrival; // 到达时刻
+        int mem;           // 显存占用 a*B+b
+        int duration;      // 推理耗时
+        long long finish;  // 完成时刻
+        bool idle;         // 到达时NPU空闲且是同一时刻到达的第一个请求(空闲点)
+        bool alive;
+    };
 
-                // 4. 迁移惩罚 (渐进式)
-                if (users[i].last_server_id != -1 &&
-                    (npus[j].server_id != users[i].last_server_id ||
-                     npus[j].id_in_server != users[i].last_npu_id_in_server))
-                {
-                    // 根据已发送请求数量调整迁移惩罚
-                    int sent_requests = solution[i].size();
-                    int migration_penalty = MIGRATION_PENALTY * (1 + sent_requests / 10);
-                    cost += migration_penalty;
-                }
+    enum class Op
+    {
+        Field,         // a=句柄, b=saved_reqs下标
+        Finish,        // a=句柄, b=旧空闲点标记, c=旧完成时刻
+        NpuInsert,     // a=NPU, b=位置
+        NpuErase,      // a=NPU, b=位置, c=句柄
+        UserInsert,    // a=用户, b=位置
+        UserErase,     // a=用户, b=位置, c=句柄
+        UserState,     // a=用户, b=旧move, c=旧end, term=旧得分项
+        Aggregate,     // a=旧K, term=旧得分项之和
+        NewHandle,     // a=句柄
+        ReuseHandle,   // a=句柄
+        ReleaseHandle, // a=句柄
+    };
 
-                // 5. 负载均衡 (考虑相对负载)
-                double avg_utilization = 0;
-                for (const auto &npu : npus)
-                {
-                    avg_utilization += npu.utilization_time;
-                }
-                avg_utilization /= npus.size();
+    struct Entry
+    {
+        Op op;
+        int a;
+        int b;
+        long long c;
+        double term;
+    };
 
-                double relative_load = npus[j].utilization_time - avg_utilization;
-                cost += static_cast<long long>(relative_load * LOAD_BALANCE_WEIGHT);
+    std::vector<Req> reqs;
+    std::vector<int> free_handles;
+    std::vector<int> npu_offset;             // [server_idx] -> 第一个NPU的npus下标
+    std::vector<std::vector<int>> npu_jobs;  // 每个NPU上的请求，按(到达时刻, 用户编号)有序
+    std::vector<std::vector<int>> user_reqs; // 每个用户的请求，按发送时刻有序
+    std::vector<long long> user_end;
+    std::vector<int> user_move;
+    std::vector<double> user_term;
+    int late_count = 0;
+    double term_sum = 0;
 
-                // 6. 服务器匹配度奖励
-                if (npus[j].server_id == users[i].last_server_id)
-                {
-                    cost /= 50; // 继续使用同一服务器的奖励
-                }
+    std::vector<Entry> journal;
+    std::vector<Req> saved_reqs;
+    std::vector<char> user_dirty, npu_dirty;
+    std::vector<int> dirty_users, dirty_npus;
+    std::vector<long long> dirty_lo, dirty_hi; // 每个NPU本次改动涉及的到达时刻范围
 
-                // 记录成本和最优B
-                cost_matrix[i][j].cost = cost;
-                cost_matrix[i][j].optimal_B = optimal_B;
+    // 回放缓冲区，重复使用避免分配
+    std::vector<std::pair<long long, int>> running;
+    std::vector<int> waiting;
 
-                // if (cost < best_cost)
-                // {
-                //     best_cost = cost;
-                //     best_user_idx = i;
-                //     best_npu_idx = j;
-                //     best_B = optimal_B;
-                //     best_finish_time = finish_time;
-                // }
-            }
-        }
+    Req make_req(int user, long long time, int npu, int B) const
+    {
+        int server_idx = npus.server_idx[npu];
+        Req r;
+        r.user = user;
+        r.time = time;
+        r.npu = npu;
+        r.B = B;
+        r.arrival = time + latency_of(server_idx, user);
+        r.mem = users.a[user] * B + users.b[user];
+        r.duration = calculate_inference_time(B, servers[server_idx].k);
+        r.finish = -1;
+        r.idle = false;
+        r.alive = true;
+        return r;
+    }
 
-        // printf("Current time: %lld\n", current_time);
-        // // 打印cost_matrix的cost值用于调试
-        // for (const auto &row : cost_matrix)
-        // {
-        //     for (const auto &info : row)
-        //     {
-        //         if (info.cost == std::numeric_limits<long long>::max())
-        //             std::cout << "INF ";
-        //         else
-        //             std::cout << info.cost << " ";
-        //     }
-        //     std::cout << "\n";
-        // }
+    bool queue_before(int x, int y) const
+    {
+        const Req &p = reqs[x], &q = reqs[y];
+        if (p.arrival != q.arrival)
+            return p.arrival < q.arrival;
+        if (p.user != q.user)
+            return p.user < q.user;
+        return x < y;
+    }
 
-        // 按概率分布采样选取best_user_idx和best_npu_idx
-        best_cost = std::numeric_limits<long long>::max();
+    bool send_before(int x, int y) const
+    {
+        return reqs[x].time != reqs[y].time ? reqs[x].time < reqs[y].time : x < y;
+    }
+
+    void log_field(int h)
+    {
+        journal.push_back({Op::Field, h, static_cast<int>(saved_reqs.size()), 0, 0.0});
+        saved_reqs.push_back(reqs[h]);
+    }
 
-        // 收集所有有效的(user_idx, npu_idx)对及其cost
-        std::vector<std::tuple<int, int, long long>> valid_options; // (user_idx, npu_idx, cost)
+    void log_handle(int h, bool reused)
+    {
+        journal.push_back({reused ? Op::ReuseHandle : Op::NewHandle, h, 0, 0, 0.0});
+    }
 
-        for (int i : user_indices)
+    void mark_npu(int n, long long arrival)
+    {
+        if (!npu_dirty[n])
         {
-            for (size_t j = 0; j < npus.size(); ++j)
-            {
-                if (cost_matrix[i][j].cost < std::numeric_limits<long long>::max())
-                {
-                    valid_options.push_back(std::make_tuple(i, j, cost_matrix[i][j].cost));
-                }
+            npu_dirty[n] = 1;
+            dirty_npus.push_back(n);
+            dirty_lo[n] = dirty_hi[n] = arrival;
+        }
+        dirty_lo[n] = std::min(dirty_lo[n], arrival);
+        dirty_hi[n] = std::max(dirty_hi[n], arrival);
+    }
+
+    void mark_user(int u)
+    {
+        if (!user_dirty[u])
+        {
+            user_dirty[u] = 1;
+            dirty_users.push_back(u);
+        }
+    }
+
+    // 把请求挂到其NPU队列和用户序列上
+    void attach(int h)
+    {
+        const Req &r = reqs[h];
+        std::vector<int> &jobs = npu_jobs[r.npu];
+        int pos = static_cast<int>(std::lower_bound(jobs.begin(), jobs.end(), h, [this](int x, int y)
+                                                    { return queue_before(x, y); }) -
+                                   jobs.begin());
+        jobs.insert(jobs.begin() + pos, h);
+        journal.push_back({Op::NpuInsert, r.npu, pos, 0, 0.0});
+
+        std::vector<int> &list = user_reqs[r.user];
+        int upos = static_cast<int>(std::lower_bound(list.begin(), list.end(), h, [this](int x, int y)
+                                                     { return send_before(x, y); }) -
+                                    list.begin());
+        list.insert(list.begin() + upos, h);
+        journal.push_back({Op::UserInsert, r.user, upos, 0, 0.0});
+
+        mark_npu(r.npu, r.arrival);
+        mark_user(r.user);
+    }
+
+    void detach(int h)
+    {
+        const Req &r = reqs[h];
+        std::vector<int> &jobs = npu_jobs[r.npu];
+        int pos = static_cast<int>(std::find(jobs.begin(), jobs.end(), h) - jobs.begin());
+        jobs.erase(jobs.begin() + pos);
+        journal.push_back({Op::NpuErase, r.npu, pos, h, 0.0});
+
+        std::vector<int> &list = user_reqs[r.user];
+        int upos = static_cast<int>(std::find(list.begin(), list.end(), h) - list.begin());
+        list.erase(list.begin() + upos);
+        journal.push_back({Op::UserErase, r.user, upos, h, 0.0});
+
+        mark_npu(r.npu, r.arrival);
+        mark_user(r.user);
+    }
+
+    // 重放受影响的NPU，再刷新完成时刻变化的用户
+    void flush()
+    {
+        journal.push_back({Op::Aggregate, late_count, 0, 0, term_sum});
+        for (int n : dirty_npus)
+        {
+            replay(n, dirty_lo[n], dirty_hi[n]);
+            npu_dirty[n] = 0;
+        }
+        dirty_npus.clear();
+        for (int u : dirty_users)
+        {
+            refresh_user(u);
+            user_dirty[u] = 0;
+        }
+        dirty_users.clear();
+    }
+
+    // 重放NPU n 上到达时刻在 [lo, hi] 内的请求发生改动后受影响的区间
+    void replay(int n, long long lo, long long hi)
+    {
+        const std::vector<int> &jobs = npu_jobs[n];
+        if (jobs.empty())
+            return;
+        int memory = servers[npus.server_idx[n]].m;
+
+        // 从到达时刻早于lo的最近一个空闲点开始，它之前的请求不受影响
+        size_t first_changed = static_cast<size_t>(std::lower_bound(jobs.begin(), jobs.end(), lo, [this](int h, long long value)
+                                                                    { return reqs[h].arrival < value; }) -
+                                                   jobs.begin());
+        size_t start = 0;
+        for (size_t idx = first_changed; idx-- > 0;)
+        {
+            if (reqs[jobs[idx]].idle)
+            {
+                start = idx;
+                break;
+            }
+        }
+
+        auto later = std::greater<std::pair<long long, int>>();
+        running.clear();
+        waiting.clear();
+        size_t next_arrival = start;
+        int used = 0;
+        int min_mem = std::numeric_limits<int>::max(); // 已到达请求的最小显存，不大于等待队列中的最小值
+        while (next_arrival < jobs.size() || !waiting.empty())
+        {
+            long long t = next_arrival < jobs.size() ? reqs[jobs[next_arrival]].arrival : std::numeric_limits<long long>::max();
+            if (!running.empty())
+                t = std::min(t, running.front().first);
+
+            while (!running.empty() && running.front().first <= t)
+            {
+                used -= running.front().second;
+                std::pop_heap(running.begin(), running.end(), later);
+                running.pop_back();
+            }
+            if (next_arrival < jobs.size() && reqs[jobs[next_arrival]].arrival <= t)
+            {
+                Req &head = reqs[jobs[next_arrival]];
+                bool idle = running.empty() && waiting.empty();
+                // 改动之后新旧回放都在此处空闲，其后的结果与原来相同
+                if (idle && head.idle && head.arrival > hi)
+                    break;
+                for (bool first = true; next_arrival < jobs.size() && reqs[jobs[next_arrival]].arrival <= t; first = false)
+                {
+                    int h = jobs[next_arrival++];
+                    bool flag = first && idle;
+                    if (reqs[h].idle != flag)
+                    {
+                        journal.push_back({Op::Finish, h, reqs[h].idle, reqs[h].finish, 0.0});
+                        reqs[h].idle = flag;
+                    }
+                    min_mem = std::min(min_mem, reqs[h].mem);
+                    waiting.push_back(h);
+                }
+            }
+
+            size_t kept = 0, w = 0;
+            for (; w < waiting.size() && memory - used >= min_mem; ++w)
+            {
+                Req &r = reqs[waiting[w]];
+                if (used + r.mem <= memory)
+                {
+                    long long finish = t + r.duration;
+                    if (finish != r.finish)
+                    {
+                        journal.push_back({Op::Finish, waiting[w], r.idle, r.finish, 0.0});
+                        r.finish = finish;
+                        mark_user(r.user);
+                    }
+                    used += r.mem;
+                    running.push_back({finish, r.mem});
+                    std::push_heap(running.begin(), running.end(), later);
+                }
+                else
+                {
+                    waiting[kept++] = waiting[w];
+                }
+            }
+            for (; w < waiting.size(); ++w)
+                waiting[kept++] = waiting[w];
+            waiting.resize(kept);
+        }
+    }
+
+    void refresh_user(int u)
+    {
+        long long end = 0;
+        int move = 0;
+        const std::vector<int> &list = user_reqs[u];
+        for (size_t j = 0; j < list.size(); ++j)
+        {
+            end = std::max(end, reqs[list[j]].finish);
+            if (j > 0 && reqs[list[j]].npu != reqs[list[j - 1]].npu)
+                ++move;
+        }
+        int s = users.s[u], e = users.e[u];
+        double lateness = static_cast<double>(end - e) / (e - s);
+        double term = list.empty() ? 0.0 : std::pow(2.0, -lateness / 100.0) * std::pow(2.0, -move / 200.0);
+
+        journal.push_back({Op::UserState, u, user_move[u], user_end[u], user_term[u]});
+        late_count += (end > e) - (user_end[u] > e);
+        term_sum += term - user_term[u];
+        user_end[u] = end;
+        user_move[u] = move;
+        user_term[u] = term;
+    }
+};
+
+// --- 就绪时刻日历 ---
+// 以(下一次发送时刻, 用户编号)为键的索引二叉堆，堆中只保留还有剩余样本的用户。
+// 支持按用户修改键值(decrease-key / increase-key)，决策循环不再每次扫描全部用户来求当前时刻和就绪用户。
+class ReadyCalendar
+{
+public:
+    void init(int user_count)
+    {
+        heap.clear();
+        heap.reserve(user_count);
+        stack.reserve(user_count);
+        pos.assign(user_count, -1);
+        key.assign(user_count, 0);
+    }
+
+    bool empty() const { return heap.empty(); }
+
+    // 最早的就绪时刻
+    long long next_time() const { return key[heap[0]]; }
+
+    bool contains(int user) const { return pos[user] != -1; }
+
+    // 插入用户或修改其就绪时刻
+    void update(int user, long long time)
+    {
+        if (pos[user] == -1)
+        {
+            pos[user] = static_cast<int>(heap.size());
+            heap.push_back(user);
+            key[user] = time;
+            sift_up(pos[user]);
+            return;
+        }
+        long long old = key[user];
+        key[user] = time;
+        if (time < old)
+            sift_up(pos[user]);
+        else
+            sift_down(pos[user]);
+    }
+
+    void erase(int user)
+    {
+        int p = pos[user];
+        if (p == -1)
+            return;
+        int last = heap.back();
+        heap.pop_back();
+        pos[user] = -1;
+        if (last == user)
+            return;
+        heap[p] = last;
+        pos[last] = p;
+        sift_up(p);
+        sift_down(pos[last]);
+    }
+
+    // 把就绪时刻不晚于 time 的用户追加到 out，只访问满足条件的堆节点
+    template <typename Container>
+    void collect_ready(long long time, Container &out)
+    {
+        stack.clear();
+        if (!heap.empty())
+            stack.push_back(0);
+        while (!stack.empty())
+        {
+            int p = stack.back();
+            stack.pop_back();
+            if (key[heap[p]] > time)
+                continue;
+            out.push_back(heap[p]);
+            for (int c = 2 * p + 1; c <= 2 * p + 2 && c < static_cast<int>(heap.size()); ++c)
+                stack.push_back(c);
+        }
+    }
+
+private:
+    std::vector<int> heap;
+    std::vector<int> pos;       // 用户在堆中的位置，-1表示不在堆中
+    std::vector<long long> key; // 用户的就绪时刻
+    std::vector<int> stack;
+
+    bool before(int x, int y) const
+    {
+        return key[x] != key[y] ? key[x] < key[y] : x < y;
+    }
+
+    void place(int p, int user)
+    {
+        heap[p] = user;
+        pos[user] = p;
+    }
+
+    void sift_up(int p)
+    {
+        int user = heap[p];
+        while (p > 0)
+        {
+            int parent = (p - 1) / 2;
+            if (!before(user, heap[parent]))
+                break;
+            place(p, heap[parent]);
+            p = parent;
+        }
+        place(p, user);
+    }
+
+    void sift_down(int p)
+    {
+        int user = heap[p];
+        int n = static_cast<int>(heap.size());
+        while (true)
+        {
+            int c = 2 * p + 1;
+            if (c >= n)
+                break;
+            if (c + 1 < n && before(heap[c + 1], heap[c]))
+                ++c;
+            if (!before(heap[c], user))
+                break;
+            place(p, heap[c]);
+            p = c;
+        }
+        place(p, user);
+    }
+};
+
+// --- 决策循环的临时缓冲区 ---
+// 每次决策所需的 cost_matrix / user_indices 等都从一块预先分配的内存中
+// 线性分配，下一次决策开始时整体重置，决策循环内不再触发堆分配。
+// 缓冲区按最坏情况(所有用户都就绪、所有NPU都可选)预留；万一不够，由上游的 new_delete_resource 兜底。
+class ScratchArena
+{
+public:
+    explicit ScratchArena(size_t bytes)
+        : buffer(bytes), resource(buffer.data(), buffer.size(), std::pmr::new_delete_resource())
+    {
+    }
+
+    // 每次决策开始时调用，之前分配的所有对象必须已经析构
+    std::pmr::memory_resource *reset()
+    {
+        resource.release();
+        return &resource;
+    }
+
+private:
+    std::vector<std::byte> buffer;
+    std::pmr::monotonic_buffer_resource resource;
+};
+
+// 单次决策最坏情况下所需的临时内存
+size_t decision_scratch_bytes()
+{
+    size_t options = static_cast<size_t>(M) * npus.size();
+    return options * sizeof(CostInfo) + static_cast<size_t>(M) * sizeof(int) + 4096;
+}
+
+// --- 成本引擎 ---
+// 决策之间只有被调度的那个用户和那个NPU的状态发生变化，因此把成本拆成三部分分别维护:
+// 1. 行缓存 [用户][服务器]: 最优B、推理耗时、效率奖励，只依赖用户的剩余样本数和已发请求数，
+//    该用户被调度后才失效重算(find_optimal_batch 的线性扫描只在这里发生)
+// 2. 列状态 [NPU]: 显存占用时间线 / utilization_time，直接读 npus
+// 3. 全局聚合: NPU累计工作时长之和，提交时 O(1) 更新，不再在内层循环里对所有NPU求平均
+// 这只是缓存，不是按成本下界排序的惰性队列: 采样需要每个候选的成本，因此每次决策仍对所有就绪候选求值，
+// 代价为 O(就绪用户数·NPU数)，但每个候选只剩 O(1) 的算术
+// 成本公式本身(make_batch_term / decision_cost)只依赖传入的状态，束搜索等其他调度器也直接复用。
+
+struct BatchTerm
+{
+    int optimal_B = -1; // -1: 显存放不下; 0: 无法满足最小B要求
+    long long inference_time = 0;
+    long long efficiency_bonus = 0;
+    int min_B = 0; // 满足300个请求上限的最小batch，按NPU显存占用缩小batch时的下限
+};
+
+// 用户i剩余 remaining_cnt 个样本、已发 sent_requests 个请求时，在服务器上的最优B及其耗时和效率奖励
+BatchTerm make_batch_term(int i, int server_idx, int remaining_cnt, int sent_requests)
+{
+    // 计算满足T_i <= 300约束的最小B
+    int remaining_requests_allowed = 300 - sent_requests;
+    int min_b_required = 1;
+    if (remaining_requests_allowed > 0)
+    {
+        min_b_required = (remaining_cnt + remaining_requests_allowed - 1) / remaining_requests_allowed;
+    }
+    else if (remaining_cnt > 0)
+    {
+        // 请求次数已达上限，必须一次性发完所有剩余样本
+        min_b_required = remaining_cnt;
+    }
+
+    BatchTerm term;
+    int max_b = max_batch_of(server_idx, i);
+    term.optimal_B = max_b <= 0 ? -1 : find_optimal_batch(servers[server_idx], max_b, remaining_cnt, min_b_required);
+    if (term.optimal_B > 0)
+    {
+        term.inference_time = calculate_inference_time(term.optimal_B, servers[server_idx].k);
+        term.efficiency_bonus = efficiency_bonus(term.optimal_B, servers[server_idx].k);
+        term.min_B = std::max(1, min_b_required);
+    }
+    return term;
+}
+
+// 成本公式用到的用户状态
+struct UserCostState
+{
+    long long next_send_time;
+    double urgency;
+    int last_npu;
+    int last_server_idx;
+    int sent_requests;
+};
+
+// 成本公式用到的NPU状态
+// timeline 非空时按显存占用时间线求开始时刻；为空时按独占模型，free_at 之后才能开始(束搜索的写时复制状态)
+struct NpuCostState
+{
+    const MemoryTimeline *timeline;
+    long long free_at;
+    long long utilization_time;
+    long long utilization_sum; // 所有NPU累计工作时长之和
+};
+
+// 用户i按 term 调度到NPU j 的成本，不可行时返回 long long 最大值
+long long decision_cost(int i, int j, long long current_time, const BatchTerm &term, const UserCostState &user,
+                        const NpuCostState &npu, int &optimal_B, long long &finish_time)
+{
+    int server_idx = npus.server_idx[j];
+    if (term.optimal_B == -1)
+        return std::numeric_limits<long long>::max(); // 显存放不下
+    if (term.optimal_B <= 0)
+    {
+        finish_time = -1;
+        return std::numeric_limits<long long>::max(); // 无法满足请求
+    }
+    optimal_B = term.optimal_B;
+    long long inference_time = term.inference_time;
+    long long bonus = term.efficiency_bonus;
+
+    long long send_time = user.next_send_time;
+    long long arrival_time = send_time + latency_of(server_idx, i);
+    long long start_time = std::max(arrival_time, npu.free_at);
+    if (npu.timeline != nullptr)
+    {
+        const Server &server = servers[server_idx];
+        start_time = npu.timeline->earliest_start(j, arrival_time, static_cast<int>(inference_time),
+                                                  users.a[i] * optimal_B + users.b[i], server.m);
+        if (start_time > arrival_time)
+        {
+            // 同时推理的请求占着显存，单个请求效率最高的batch要排队: 改为在到达时的空闲显存内
+            // 按NPU每毫秒推理的样本数选batch，到达即开始(耗时不超过原batch，窗口是原窗口的前缀)
+            int occupied = npu.timeline->max_occupancy(j, arrival_time, arrival_time + inference_time);
+            int packed = find_packed_batch(server, users.a[i], users.b[i], server.m - occupied, term.min_B, optimal_B - 1);
+            if (packed > 0)
+            {
+                optimal_B = packed;
+                inference_time = calculate_inference_time(packed, server.k);
+                bonus = efficiency_bonus(packed, server.k);
+                start_time = arrival_time;
+            }
+        }
+    }
+    finish_time = start_time + inference_time;
+
+    // 改进的成本函数 - 考虑更多因素
+    long long time_over_deadline = std::max(0LL, finish_time - users.e[i]);
+    long long cost = finish_time;
+
+    // 1. 截止时间惩罚 (非线性)
+    if (time_over_deadline > 0)
+    {
+        cost += time_over_deadline * time_over_deadline / 1000 + time_over_deadline * DEADLINE_PENALTY_WEIGHT;
+    }
+
+    // 2. 紧急度因子
+    long long remaining_time = std::max(1LL, users.e[i] - current_time);
+    if (remaining_time < 10000)
+    { // 时间紧张时
+        cost = static_cast<long long>(cost * (1.0 + user.urgency * 0.1));
+    }
+
+    // 3. 效率奖励 - 选择高效batch的奖励
+    cost -= bonus;
+
+    // 4. 迁移惩罚 (渐进式)
+    if (user.last_npu != -1 && j != user.last_npu)
+    {
+        // 根据已发送请求数量调整迁移惩罚
+        int migration_penalty = MIGRATION_PENALTY * (1 + user.sent_requests / 10);
+        cost += migration_penalty;
+    }
+
+    // 4.1 共置规划: 引导用户发往规划的NPU
+    if (!home_npu.empty() && home_npu[i] != -1 && j != home_npu[i])
+    {
+        cost += COLOCATION_PENALTY;
+    }
+
+    // 5. 负载均衡 (考虑相对负载)
+    double avg_utilization = static_cast<double>(npu.utilization_sum) / npus.size();
+    double relative_load = npu.utilization_time - avg_utilization;
+    cost += static_cast<long long>(relative_load * LOAD_BALANCE_WEIGHT);
+
+    // 6. 服务器匹配度奖励
+    if (server_idx == user.last_server_idx)
+    {
+        cost /= 50; // 继续使用同一服务器的奖励
+    }
+    return cost;
+}
+
+class CostEngine
+{
+public:
+    void init()
+    {
+        terms.assign(static_cast<size_t>(M) * N, BatchTerm());
+        row_dirty.assign(M, 1);
+        utilization_sum = 0;
+        for (long long utilization : npus.utilization_time)
+            utilization_sum += utilization;
+    }
+
+    // 用户被调度后，其行缓存失效
+    void invalidate_user(int i)
+    {
+        row_dirty[i] = 1;
+    }
+
+    // NPU累计工作时长增加
+    void add_utilization(long long delta)
+    {
+        utilization_sum += delta;
+    }
+
+    // 重算失效的行缓存
+    void prepare_user(int i, int sent_requests)
+    {
+        if (!row_dirty[i])
+            return;
+        row_dirty[i] = 0;
+        for (int server_idx = 0; server_idx < N; ++server_idx)
+        {
+            terms[i * N + server_idx] = make_batch_term(i, server_idx, users.remaining_cnt[i], sent_requests);
+        }
+    }
+
+    // 计算用户i调度到NPU j的成本，不可行时返回 long long 最大值
+    long long evaluate(int i, int j, long long current_time, int sent_requests, int &optimal_B, long long &finish_time) const
+    {
+        UserCostState user{users.next_send_time[i], users.urgency[i], users.last_npu[i], users.last_server_idx[i], sent_requests};
+        NpuCostState npu{&npus.timeline, 0, npus.utilization_time[j], utilization_sum};
+        return decision_cost(i, j, current_time, terms[i * N + npus.server_idx[j]], user, npu, optimal_B, finish_time);
+    }
+
+private:
+    std::vector<BatchTerm> terms; // [user_idx * N + server_idx]
+    std::vector<char> row_dirty;
+    long long utilization_sum = 0;
+};
+
+// --- 候选采样器 ---
+// 原实现先算 exp(utility / SOFTMAX_TEMPERATURE) 再归一化，温度为1e-7时指数溢出为inf，概率变成NaN，
+// 实际效果是总选第一个有效候选。这里改在对数域用Gumbel-max采样: 对每个候选计算
+// log(权重) + Gumbel噪声，取最大者，恰好按 softmax(log(权重)) 分布抽样，不需要求指数和归一化。
+// 两种模式与原实现相同:
+// - 候选不超过 RANK_MODE_LIMIT 个: 权重按成本排名，log(权重) = (n - rank + 0.5) / (2T)。
+//   先按排名权重抽出一个名次，再用 nth_element 找到该名次的候选，不需要完整排序
+// - 候选更多: 成本归一化到[0, 1]，log(权重) = (1 - (cost - min) / range) / T，一次流式扫描完成抽样
+// 候选直接从 cost_matrix 中读取，排名模式的候选存在定长数组中，采样过程不分配内存。
+class CandidateSampler
+{
+public:
+    static const int RANK_MODE_LIMIT = 50;
+
+    explicit CandidateSampler(double temperature) : temperature(temperature) {}
+
+    // 在 rows*cols 的成本矩阵中按分布抽取一个有效候选(cost不为INF)，返回展平下标，没有候选时返回-1
+    template <typename Rng>
+    int sample(const CostInfo *costs, size_t rows, size_t cols, Rng &rng)
+    {
+        const long long INF = std::numeric_limits<long long>::max();
+        const size_t total = rows * cols;
+        size_t count = 0;
+        long long min_cost = INF;
+        long long max_cost = std::numeric_limits<long long>::min();
+        int only = -1;
+        for (size_t idx = 0; idx < total; ++idx)
+        {
+            long long cost = costs[idx].cost;
+            if (cost == INF)
+                continue;
+            if (count < static_cast<size_t>(RANK_MODE_LIMIT))
+                ranked[count] = {cost, static_cast<int>(idx)};
+            ++count;
+            min_cost = std::min(min_cost, cost);
+            max_cost = std::max(max_cost, cost);
+            only = static_cast<int>(idx);
+        }
+
+        if (count <= 1)
+            return only;
+        if (count <= static_cast<size_t>(RANK_MODE_LIMIT))
+            return sample_by_rank(static_cast<int>(count), rng);
+        return sample_by_cost(costs, total, min_cost, max_cost, rng);
+    }
+
+private:
+    // 标准Gumbel分布的随机数 -log(-log(U))
+    template <typename Rng>
+    static double gumbel(Rng &rng)
+    {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        double u = unit(rng);
+        if (u <= 0.0)
+            u = std::numeric_limits<double>::min();
+        return -std::log(-std::log(u));
+    }
+
+    template <typename Rng>
+    int sample_by_rank(int n, Rng &rng)
+    {
+        // 名次r(0为成本最低)的对数权重为 (n - r + 0.5) / (2T)
+        int rank = 0;
+        double best_key = -std::numeric_limits<double>::infinity();
+        for (int r = 0; r < n; ++r)
+        {
+            double key = (n - r + 0.5) / (temperature * 2.0) + gumbel(rng);
+            if (key > best_key)
+            {
+                best_key = key;
+                rank = r;
+            }
+        }
+        std::nth_element(ranked.begin(), ranked.begin() + rank, ranked.begin() + n);
+        return ranked[rank].second;
+    }
+
+    template <typename Rng>
+    int sample_by_cost(const CostInfo *costs, size_t total, long long min_cost, long long max_cost, Rng &rng)
+    {
+        const long long INF = std::numeric_limits<long long>::max();
+        const double cost_range = static_cast<double>(std::max(1LL, max_cost - min_cost));
+        int selected = -1;
+        double best_key = -std::numeric_limits<double>::infinity();
+        for (size_t idx = 0; idx < total; ++idx)
+        {
+            long long cost = costs[idx].cost;
+            if (cost == INF)
+                continue;
+            // cost小的utility大
+            double utility = 1.0 - static_cast<double>(cost - min_cost) / cost_range;
+            double key = utility / temperature + gumbel(rng);
+            if (key > best_key)
+            {
+                best_key = key;
+                selected = static_cast<int>(idx);
+            }
+        }
+        return selected;
+    }
+
+    double temperature;
+    std::array<std::pair<long long, int>, RANK_MODE_LIMIT> ranked; // 排名模式的候选 (cost, 展平下标)
+};
+
+// --- 计数器随机数 ---
+// Philox4x32-10: 输出是 (密钥, 计数器) 的双射，不保存内部状态。密钥取种子，计数器高64位取 (线程, 第几次重启)，
+// 低64位逐块递增，因此每次随机贪心都有独立且可按 (seed, thread, restart) 精确重放的随机流，与线程调度顺序无关。
+class Philox4x32
+{
+public:
+    using result_type = uint32_t;
+
+    Philox4x32(uint64_t seed, uint32_t thread, uint32_t restart)
+        : key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}, counter{0, 0, restart, thread}
+    {
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+    result_type operator()()
+    {
+        if (used == 4)
+        {
+            refill();
+        }
+        return block[used++];
+    }
+
+private:
+    static constexpr uint32_t MUL0 = 0xD2511F53, MUL1 = 0xCD9E8D57;
+    static constexpr uint32_t WEYL0 = 0x9E3779B9, WEYL1 = 0xBB67AE85;
+
+    void refill()
+    {
+        std::array<uint32_t, 4> x = counter;
+        std::array<uint32_t, 2> k = key;
+        for (int round = 0; round < 10; ++round)
+        {
+            if (round > 0)
+            {
+                k[0] += WEYL0;
+                k[1] += WEYL1;
+            }
+            uint64_t p0 = static_cast<uint64_t>(MUL0) * x[0];
+            uint64_t p1 = static_cast<uint64_t>(MUL1) * x[2];
+            x = {static_cast<uint32_t>(p1 >> 32) ^ x[1] ^ k[0], static_cast<uint32_t>(p1),
+                 static_cast<uint32_t>(p0 >> 32) ^ x[3] ^ k[1], static_cast<uint32_t>(p0)};
+        }
+        block = x;
+        used = 0;
+        if (++counter[0] == 0)
+        {
+            ++counter[1];
+        }
+    }
+
+    std::array<uint32_t, 2> key;
+    std::array<uint32_t, 4> counter;
+    std::array<uint32_t, 4> block{};
+    int used = 4;
+};
+
+// --- 共置规划 ---
+// 用户的 (a, b) 各不相同，有的用户组合能把NPU显存几乎填满，有的会浪费几百MB。共置规划在贪心之前为每个用户指定一个NPU，
+// 按时间上的向量装箱处理: 用户在服务器上按 find_optimal_batch 的batch、每 时延+1 毫秒发一个请求，平均占用显存
+// (a*B+b) * min(1, 推理耗时/(时延+1))，占用时段为 [s, 预计完成时刻)；每个NPU维护按时段端点离散化的占用曲线。
+// 用户按 平均占用 * 时长 从大到小依次放置: 只考虑能在截止时刻前完成的服务器(都不能时考虑完成最早的)，
+// 在这些服务器的NPU中选放入后占用时段内峰值最接近显存上限且不超过的一个(最佳适配)；都放不下的用户不指定NPU。
+// 贪心的成本函数对不发往指定NPU的候选加 COLOCATION_PENALTY，用户因此集中在规划的NPU上，不额外增加迁移。
+struct ColocationSlot
+{
+    bool usable = false;
+    double footprint = 0; // 平均占用显存
+    long long end = 0;    // 预计完成时刻
+};
+
+std::vector<int> plan_colocation()
+{
+    std::vector<std::vector<ColocationSlot>> slots(M, std::vector<ColocationSlot>(N));
+    std::vector<long long> points;
+    std::vector<double> weight(M, 0);
+    for (int i = 0; i < M; ++i)
+    {
+        points.push_back(users.s[i]);
+        for (int server_idx = 0; server_idx < N; ++server_idx)
+        {
+            int max_b = max_batch_of(server_idx, i);
+            if (max_b <= 0)
+                continue;
+            const Server &server = servers[server_idx];
+            int B = find_optimal_batch(server, max_b, users.cnt[i], (users.cnt[i] + 299) / 300);
+            if (B <= 0)
+                continue;
+            int cadence = latency_of(server_idx, i) + 1;
+            int time = calculate_inference_time(B, server.k);
+            ColocationSlot &slot = slots[i][server_idx];
+            slot.usable = true;
+            slot.footprint = static_cast<double>(users.a[i] * B + users.b[i]) * std::min(1.0, static_cast<double>(time) / cadence);
+            slot.end = users.s[i] + static_cast<long long>((users.cnt[i] + B - 1) / B - 1) * cadence + cadence - 1 + time;
+            points.push_back(slot.end);
+            weight[i] = std::max(weight[i], slot.footprint * (slot.end - users.s[i]));
+        }
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    auto point_of = [&](long long t)
+    { return static_cast<int>(std::lower_bound(points.begin(), points.end(), t) - points.begin()); };
+
+    std::vector<int> order(M);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y)
+                     { return weight[x] > weight[y]; });
+
+    std::vector<std::vector<double>> load(npus.size(), std::vector<double>(points.size(), 0.0)); // [NPU][时段]
+    std::vector<int> home(M, -1);
+    for (int i : order)
+    {
+        // 能按时完成的服务器；都不能时取完成最早的
+        long long earliest = std::numeric_limits<long long>::max();
+        for (int server_idx = 0; server_idx < N; ++server_idx)
+        {
+            if (slots[i][server_idx].usable)
+                earliest = std::min(earliest, slots[i][server_idx].end);
+        }
+        long long allowed_end = std::max<long long>(earliest, users.e[i]);
+
+        int best = -1;
+        double best_left = std::numeric_limits<double>::infinity();
+        for (size_t j = 0; j < npus.size(); ++j)
+        {
+            const ColocationSlot &slot = slots[i][npus.server_idx[j]];
+            if (!slot.usable || slot.end > allowed_end)
+                continue;
+            double peak = 0;
+            for (int p = point_of(users.s[i]), last = point_of(slot.end); p < last; ++p)
+                peak = std::max(peak, load[j][p]);
+            double left = servers[npus.server_idx[j]].m - peak - slot.footprint;
+            if (left >= 0 && left < best_left)
+            {
+                best_left = left;
+                best = static_cast<int>(j);
+            }
+        }
+        if (best == -1)
+            continue;
+        home[i] = best;
+        const ColocationSlot &slot = slots[i][npus.server_idx[best]];
+        for (int p = point_of(users.s[i]), last = point_of(slot.end); p < last; ++p)
+            load[best][p] += slot.footprint;
+    }
+    return home;
+}
+
+// --- 流水线规划 ---
+// 用户每 时延+1 毫秒就可以发下一个请求，不必等前面的请求推理完，同一NPU上的请求也不计迁移；贪心却按NPU空闲时刻
+// 逐个排请求，一个用户的请求在时间上几乎不重叠。流水线规划直接为每个用户构造整条发送序列: 按 find_pipelined_batch
+// 的batch从 s 起每 时延+1 毫秒向同一个NPU发一个请求(最后一个请求发剩余样本)，前后请求在显存中重叠推理，
+// 用户以最大发送速率在单个NPU上完成，迁移次数为0。
+// 用户按 s 从早到晚依次规划，在每个NPU的显存占用时间线上逐个请求试探到达与开始时刻(试探后撤销)，
+// 选最后完成最早的NPU(有共置规划时用指定的NPU)，再把这些请求计入时间线。
+//
+// 条带化(--stripe): 单个NPU的显存放不下足够多同时推理的请求时，用户在一个NPU上赶不上截止时刻。
+// 这样的用户改为在同一服务器的 n 个NPU上轮流发送，每个NPU每 n*(时延+1) 毫秒收到一个请求，batch按 n 个NPU的显存选，
+// 代价是每个请求都换一次NPU(请求数-1次迁移)。对每个服务器、每个 n 构造方案(NPU取单NPU试探中完成最早的 n 个)，
+// 每个服务器上 n 从2起增加到能按时完成为止。按得分函数估计用户的贡献 h(是否超时) * (M - 1 + h(超时比例) * p(迁移次数))
+// (其他用户的得分项按1计)，与单NPU方案一起取估计值最大的方案: 超时一个用户使总分乘 h(1)，约损失0.7%，
+// 远大于几十次迁移对单个用户得分项的影响，但超时无法避免时不为缩短超时而多迁移。不用贪心的 MIGRATION_PENALTY。
+
+// 在 npu_set 上从 s 起轮流发送用户 i 的请求并计入时间线，返回最后完成时刻；plan / starts 为各请求及其开始时刻
+long long place_stripe(MemoryTimeline &timeline, int i, const std::vector<int> &npu_set, int B,
+                       std::vector<ScheduledRequest> &plan, std::vector<long long> &starts)
+{
+    int server_idx = npus.server_idx[npu_set[0]];
+    const Server &server = servers[server_idx];
+    int latency = latency_of(server_idx, i);
+    plan.clear();
+    starts.clear();
+    long long end = 0;
+    long long send = users.s[i];
+    for (int left = users.cnt[i]; left > 0; send += latency + 1)
+    {
+        int j = npu_set[plan.size() % npu_set.size()];
+        int batch = std::min(left, B);
+        left -= batch;
+        int time = calculate_inference_time(batch, server.k);
+        int memory = users.a[i] * batch + users.b[i];
+        long long start = timeline.earliest_start(j, send + latency, time, memory, server.m);
+        timeline.occupy(j, start, start + time, memory);
+        end = std::max(end, start + time);
+        plan.push_back({i + 1, send, server_idx + 1, npus.id_in_server[j], batch});
+        starts.push_back(start);
+    }
+    return end;
+}
+
+// 撤销 place_stripe 计入的占用
+void undo_stripe(MemoryTimeline &timeline, int i, const std::vector<ScheduledRequest> &plan, const std::vector<long long> &starts)
+{
+    for (size_t r = 0; r < plan.size(); ++r)
+    {
+        int server_idx = plan[r].server_id - 1;
+        int time = calculate_inference_time(plan[r].B, servers[server_idx].k);
+        timeline.occupy(npu_index_of(server_idx, plan[r].npu_id_in_server), starts[r], starts[r] + time,
+                        -(users.a[i] * plan[r].B + users.b[i]));
+    }
+}
+
+// 按得分函数估计用户 i 以 end 完成、迁移 moves 次时对总分的贡献(其他用户的得分项按1计)
+double stripe_value(int i, long long end, int moves)
+{
+    double lateness = static_cast<double>(end - users.e[i]) / (users.e[i] - users.s[i]);
+    double term = std::pow(2.0, -lateness / 100.0) * std::pow(2.0, -moves / 200.0);
+    return (end > users.e[i] ? std::pow(2.0, -1 / 100.0) : 1.0) * (M - 1 + term);
+}
+
+void plan_pipeline(std::vector<std::vector<ScheduledRequest>> &solution, bool stripe)
+{
+    solution.assign(M, {});
+    MemoryTimeline timeline;
+    timeline.init(npus.size());
+
+    std::vector<int> order(M);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [](int x, int y)
+                     { return users.s[x] < users.s[y]; });
+
+    std::vector<int> batch(N);
+    std::vector<long long> single_end(npus.size());
+    std::vector<int> npu_set, best_set, ranked;
+    std::vector<ScheduledRequest> plan, best_plan;
+    std::vector<long long> starts;
+    for (int i : order)
+    {
+        int min_b = (users.cnt[i] + 299) / 300;
+        for (int server_idx = 0; server_idx < N; ++server_idx)
+        {
+            batch[server_idx] = find_pipelined_batch(servers[server_idx], users.a[i], users.b[i], latency_of(server_idx, i) + 1,
+                                                     min_b, std::min(users.cnt[i], max_batch_of(server_idx, i)), 1);
+        }
+
+        long long best_end = std::numeric_limits<long long>::max();
+        best_set.clear();
+        for (size_t j = 0; j < npus.size(); ++j)
+        {
+            single_end[j] = std::numeric_limits<long long>::max();
+            int server_idx = npus.server_idx[j];
+            if (batch[server_idx] <= 0 || (!home_npu.empty() && home_npu[i] != -1 && home_npu[i] != static_cast<int>(j)))
+                continue;
+            npu_set.assign(1, static_cast<int>(j));
+            single_end[j] = place_stripe(timeline, i, npu_set, batch[server_idx], plan, starts);
+            undo_stripe(timeline, i, plan, starts);
+            if (single_end[j] < best_end)
+            {
+                best_end = single_end[j];
+                best_set = npu_set;
+                best_plan.swap(plan);
+            }
+        }
+
+        if (stripe && !best_set.empty() && best_end > users.e[i])
+        {
+            double best_value = stripe_value(i, best_end, 0);
+            for (int server_idx = 0; server_idx < N; ++server_idx)
+            {
+                ranked.clear();
+                for (int j = server_npu_offset[server_idx], last = j + servers[server_idx].g; j < last; ++j)
+                {
+                    if (single_end[j] != std::numeric_limits<long long>::max())
+                        ranked.push_back(j);
+                }
+                std::stable_sort(ranked.begin(), ranked.end(), [&](int x, int y)
+                                 { return single_end[x] < single_end[y]; });
+                for (size_t n = 2; n <= ranked.size(); ++n)
+                {
+                    int B = find_pipelined_batch(servers[server_idx], users.a[i], users.b[i], latency_of(server_idx, i) + 1, min_b,
+                                                 std::min(users.cnt[i], max_batch_of(server_idx, i)), static_cast<int>(n));
+                    npu_set.assign(ranked.begin(), ranked.begin() + n);
+                    long long end = place_stripe(timeline, i, npu_set, B, plan, starts);
+                    undo_stripe(timeline, i, plan, starts);
+                    double value = stripe_value(i, end, static_cast<int>(plan.size()) - 1);
+                    if (value > best_value)
+                    {
+                        best_value = value;
+                        best_set = npu_set;
+                        best_plan.swap(plan);
+                    }
+                    if (end <= users.e[i])
+                        break; // 能按时完成的最少NPU数
+                }
+            }
+        }
+        if (best_set.empty())
+            continue;
+
+        // 重放选中的方案并计入时间线
+        place_stripe(timeline, i, best_set, best_plan[0].B, plan, starts);
+        solution[i] = plan;
+    }
+}
+
+// --- 主调度逻辑 ---
+
+using Solution = std::vector<std::vector<ScheduledRequest>>;
+
+class RolloutPlanner;
+// 有争议的决策返回 rollout 选中的候选在 costs 中的展平下标，否则返回-1 (定义见 rollout 前瞻一节)
+int rollout_choose(RolloutPlanner &planner, const CostInfo *costs, const int *user_indices, size_t rows, size_t cols,
+                   const Solution &solution);
+
+// 把 users / npus 的热字段恢复到尚未调度任何请求的状态
+void reset_schedule_state()
+{
+    for (int i = 0; i < M; ++i)
+    {
+        users.remaining_cnt[i] = users.cnt[i];
+        users.next_send_time[i] = users.s[i];
+        users.urgency[i] = 0;
+        users.last_npu[i] = -1;
+        users.last_server_idx[i] = -1;
+    }
+    npus.timeline.reset();
+    std::fill(npus.busy_until.begin(), npus.busy_until.end(), 0);
+    std::fill(npus.utilization_time.begin(), npus.utilization_time.end(), 0);
+}
+
+// 一次随机贪心，从头构造完整方案。返回决策循环中的堆分配次数(只在 ALLOC_STATS 下统计，否则为0)
+// pinned 非空时，pinned[i] 作为用户 i 的请求前缀原样沿用，到发送时刻直接提交(计入NPU负载)，不参与决策；
+// 前缀用完后剩余样本由贪心继续调度。pinned[i] 覆盖全部样本的用户不再参与决策，为空的用户从头重新调度。
+// planner 非空时，有争议的决策交给 rollout 前瞻选择(见 RolloutPlanner)
+template <typename Rng>
+long long run_greedy(Rng &gen, double temperature, Solution &solution, const Solution *pinned = nullptr,
+                     RolloutPlanner *planner = nullptr)
+{
+    reset_schedule_state();
+    solution.assign(M, {});
+    for (auto &requests : solution)
+    {
+        requests.reserve(300);
+    }
+    auto is_pinned = [pinned, &solution](int i)
+    {
+        return pinned != nullptr && solution[i].size() < (*pinned)[i].size();
+    };
+    for (int i = 0; i < M; ++i)
+    {
+        if (is_pinned(i))
+        {
+            users.next_send_time[i] = (*pinned)[i][0].time;
+        }
+    }
+    long long total_remaining_cnt = 0;
+    for (int i = 0; i < M; ++i)
+    {
+        total_remaining_cnt += users.cnt[i];
+    }
+
+    ScratchArena scratch(decision_scratch_bytes());
+    CostEngine cost_engine;
+    cost_engine.init();
+    CandidateSampler sampler(temperature);
+    ReadyCalendar calendar;
+    calendar.init(M);
+    for (int i = 0; i < M; ++i)
+    {
+        if (users.remaining_cnt[i] > 0)
+        {
+            calendar.update(i, users.next_send_time[i]);
+        }
+    }
+
+    // 把用户在 next_send_time 发往 npu_idx 的请求记入方案并更新状态
+    auto commit = [&](int user, int npu_idx, int B, long long finish_time)
+    {
+        long long send_time = users.next_send_time[user];
+        int server_idx = npus.server_idx[npu_idx];
+        int npu_id = npus.id_in_server[npu_idx];
+
+        solution[user].push_back({user + 1, send_time, server_idx + 1, npu_id, B});
+
+        // 更新状态
+        users.remaining_cnt[user] -= B;
+        total_remaining_cnt -= B;
+
+        users.last_server_idx[user] = server_idx;
+        users.last_npu[user] = npu_idx;
+
+        // 题目规则: 用户可在第 x+latency+1 毫秒发送下一个请求
+        int latency = latency_of(server_idx, user);
+        users.next_send_time[user] = send_time + latency + 1;
+        if (is_pinned(user))
+        {
+            users.next_send_time[user] = (*pinned)[user][solution[user].size()].time;
+        }
+        if (users.remaining_cnt[user] > 0)
+        {
+            calendar.update(user, users.next_send_time[user]);
+        }
+        else
+        {
+            calendar.erase(user);
+        }
+
+        long long inference_time = calculate_inference_time(B, servers[server_idx].k);
+        npus.timeline.occupy(npu_idx, finish_time - inference_time, finish_time, users.a[user] * B + users.b[user]);
+        npus.busy_until[npu_idx] = std::max(npus.busy_until[npu_idx], finish_time);
+        npus.utilization_time[npu_idx] += inference_time;
+        cost_engine.add_utilization(inference_time);
+        cost_engine.invalidate_user(user);
+    };
+
+#ifdef ALLOC_STATS
+    long long allocations_before_loop = g_heap_allocations;
+#endif
+
+    // 修复变量遮蔽问题 - 移除重复声明
+    while (total_remaining_cnt > 0)
+    {
+        std::pmr::memory_resource *arena = scratch.reset();
+
+        if (calendar.empty())
+        {
+            break; // 所有用户处理完毕
+        }
+        long long current_time = calendar.next_time();
+
+        // 按紧急度对用户排序，优先处理紧急的用户
+        // 先按编号排好，使相同紧急度的用户保持编号顺序下的排序结果
+        std::pmr::vector<int> user_indices(arena);
+        user_indices.reserve(M);
+        calendar.collect_ready(current_time, user_indices);
+        std::sort(user_indices.begin(), user_indices.end());
+
+        // 沿用的请求到时直接提交，按用户编号顺序
+        if (pinned != nullptr)
+        {
+            size_t kept = 0;
+            for (int i : user_indices)
+            {
+                if (!is_pinned(i))
+                {
+                    user_indices[kept++] = i;
+                    continue;
+                }
+                const ScheduledRequest &r = (*pinned)[i][solution[i].size()];
+                int npu_idx = npu_index_of(r.server_id - 1, r.npu_id_in_server);
+                const Server &server = servers[r.server_id - 1];
+                int inference_time = calculate_inference_time(r.B, server.k);
+                long long start = npus.timeline.earliest_start(npu_idx, current_time + latency_of(r.server_id - 1, i),
+                                                               inference_time, users.a[i] * r.B + users.b[i], server.m);
+                commit(i, npu_idx, r.B, start + inference_time);
+            }
+            user_indices.resize(kept);
+            if (user_indices.empty())
+            {
+                continue;
+            }
+        }
+
+        // 更新用户紧急度
+        update_user_urgency(current_time, user_indices);
+
+        std::sort(user_indices.begin(), user_indices.end(), [](int a, int b)
+                  {
+                      return users.urgency[a] > users.urgency[b]; // 紧急度高的优先
+                  });
+
+        // --- 在current_time进行调度决策 ---
+        long long best_cost = std::numeric_limits<long long>::max();
+        int best_user_idx = -1;
+        int best_npu_idx = -1;
+        int best_B = -1;
+        long long best_finish_time = -1;
+
+        // 只为就绪用户建行，按 [user_indices中的行][NPU] 展平存储
+        const size_t npu_count = npus.size();
+        std::pmr::vector<CostInfo> cost_matrix(user_indices.size() * npu_count, arena);
+
+        // 遍历按紧急度排序的用户
+        for (size_t row = 0; row < user_indices.size(); ++row)
+        {
+            int i = user_indices[row];
+            int sent_requests = static_cast<int>(solution[i].size());
+            cost_engine.prepare_user(i, sent_requests);
+
+            // 遍历所有NPU，为该用户寻找最佳调度方案
+            for (size_t j = 0; j < npu_count; ++j)
+            {
+                CostInfo &info = cost_matrix[row * npu_count + j];
+                info.cost = cost_engine.evaluate(i, static_cast<int>(j), current_time, sent_requests,
+                                                 info.optimal_B, info.finish_time);
+            }
+        }
+
+        // printf("Current time: %lld\n", current_time);
+        // // 打印cost_matrix的cost值用于调试
+        // for (const auto &row : cost_matrix)
+        // {
+        //     for (const auto &info : row)
+        //     {
+        //         if (info.cost == std::numeric_limits<long long>::max())
+        //             std::cout << "INF ";
+        //         else
+        //             std::cout << info.cost << " ";
+        //     }
+        //     std::cout << "\n";
+        // }
+
+        // 按概率分布采样选取best_user_idx和best_npu_idx
+        best_cost = std::numeric_limits<long long>::max();
+        int selected = -1;
+        if (planner != nullptr)
+        {
+            selected = rollout_choose(*planner, cost_matrix.data(), user_indices.data(), user_indices.size(),
+                                      npu_count, solution);
+        }
+        if (selected == -1)
+        {
+            selected = sampler.sample(cost_matrix.data(), user_indices.size(), npu_count, gen);
+        }
+        if (selected != -1)
+        {
+            int best_row = selected / static_cast<int>(npu_count);
+            best_user_idx = user_indices[best_row];
+            best_npu_idx = selected % static_cast<int>(npu_count);
+            const CostInfo &best_info = cost_matrix[selected];
+            best_B = best_info.optimal_B;
+            best_finish_time = best_info.finish_time;
+            best_cost = best_info.cost;
+        }
+
+        // --- 执行最优调度 ---
+        if (best_user_idx != -1)
+        {
+            commit(best_user_idx, best_npu_idx, best_B, best_finish_time);
+        }
+        else
+        {
+            // --- 死循环处理 ---
+            // 在当前时间点，所有就绪的用户都无法找到任何一个NPU进行有效调度
+            // (通常因为min_b_required过大，所有服务器均不满足)
+            // 必须强制推进时间，否则会无限循环
+            long long next_possible_event_time = std::numeric_limits<long long>::max();
+
+            // 找到下一个NPU释放的时刻
+            for (long long busy_until : npus.busy_until)
+            {
+                if (busy_until > current_time)
+                {
+                    next_possible_event_time = std::min(next_possible_event_time, busy_until);
+                }
+            }
+
+            if (next_possible_event_time == std::numeric_limits<long long>::max())
+            {
+                // 如果所有NPU都已空闲，但依然无法调度，说明存在根本性的逻辑冲突，无法解决
+                break;
+            }
+
+            // 把所有被卡住的用户一次推进到下一个NPU释放时刻，以打破僵局；
+            // 日历随之跳到该时刻与其他用户就绪时刻中较早的一个
+            if (user_indices.empty())
+            {
+                // 如果没有找到任何一个卡住的用户（理论上不应该），则直接退出
+                break;
+            }
+            for (int i : user_indices)
+            {
+                users.next_send_time[i] = next_possible_event_time;
+                calendar.update(i, next_possible_event_time);
+            }
+        }
+    }
+
+#ifdef ALLOC_STATS
+    return g_heap_allocations - allocations_before_loop;
+#else
+    return 0;
+#endif
+}
+
+// --- 时间预算 ---
+// 限时运行时，到 flush_at 时刻无论改进是否结束都写出当前最优方案；flush_at = 起始时刻 + 时限 - 安全余量。
+using Clock = std::chrono::steady_clock;
+
+struct TimeBudget
+{
+    bool limited = false;
+    Clock::time_point flush_at;
+
+    // 再做一个预计耗时 step 的改进步骤是否仍在 flush_at 之前完成
+    bool allows(Clock::duration step) const
+    {
+        return !limited || Clock::now() + step < flush_at;
+    }
+};
+
+// 限时运行时从 from 到 flush_at 之间切出前 share 的一段作为一个阶段的预算
+TimeBudget budget_slice(const TimeBudget &budget, Clock::time_point from, double share)
+{
+    TimeBudget slice = budget;
+    if (budget.limited && from < budget.flush_at)
+    {
+        slice.flush_at = from + std::chrono::duration_cast<Clock::duration>((budget.flush_at - from) * share);
+    }
+    return slice;
+}
+
+// 限时运行并带改进阶段时，随机贪心所占的时间比例
+const double GREEDY_BUDGET_SHARE = 0.1;
+// 缺省随机种子；不加参数的提交运行单线程、不限时，输出可复现
+const uint64_t DEFAULT_SEED = 1;
+
+// 输出方案
+void write_solution(const Solution &solution)
+{
+    for (int i = 0; i < M; ++i)
+    {
+        std::cout << solution[i].size() << "\n";
+        for (size_t j = 0; j < solution[i].size(); ++j)
+        {
+            std::cout << solution[i][j].time << " "
+                      << solution[i][j].server_id << " "
+                      << solution[i][j].npu_id_in_server << " "
+                      << solution[i][j].B;
+            if (j < solution[i].size() - 1)
+            {
+                std::cout << " ";
+            }
+        }
+        std::cout << "\n";
+    }
+
+    std::cout.flush(); // 强制清空输出缓存
+}
+
+// --- 多起点 ---
+// 第一次贪心(线程0的第0次)使用 SOFTMAX_TEMPERATURE，即原来的贪心结果；其余各次用探索温度采样。
+// 第 r 次贪心(全局编号)由线程 r % threads 执行，是该线程的第 r / threads 次，随机流键为 (seed, 线程, 线程内编号)。
+// 每次的方案都用精确评估器打分，得分相同时取全局编号小的，结果与线程的执行快慢无关(限时运行时跑到第几次取决于速度)。
+struct PassResult
+{
+    double score = -1;
+    long long index = -1; // 全局编号 restart * threads + thread
+    int thread = -1;
+    int restart = -1;
+    const char *phase = "greedy"; // 产生该方案的阶段
+    long long loop_allocations = 0;
+    Solution solution;
+};
+
+double pass_temperature(int thread, int restart, double exploration_temperature)
+{
+    return thread == 0 && restart == 0 ? SOFTMAX_TEMPERATURE : exploration_temperature;
+}
+
+// --- 当前最优方案 ---
+// 各线程得到更好的方案时提交到这里，看门狗线程在时限到达时直接把它写出，因此任何时刻都有一份完整可行的方案可用。
+class Incumbent
+{
+public:
+    // 得分更高、或得分相同但全局编号更小时接受候选(交换走其中的方案)，返回是否接受
+    bool offer(PassResult &candidate)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (flushed)
+            return false;
+        if (best.index >= 0 && !(candidate.score > best.score || (candidate.score == best.score && candidate.index < best.index)))
+            return false;
+        std::swap(best, candidate);
+        return true;
+    }
+
+    // 写出当前最优方案，只写一次；已经写出过时返回false
+    bool flush()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (flushed || best.index < 0)
+            return false;
+        write_solution(best.solution);
+        flushed = true;
+        return true;
+    }
+
+    double score()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return best.score;
+    }
+
+    PassResult snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return best;
+    }
+
+    // 只在所有线程结束后调用
+    const PassResult &result() const { return best; }
+
+private:
+    std::mutex mutex;
+    PassResult best;
+    bool flushed = false;
+};
+
+// 时限到达时写出当前最优方案并立即结束进程，不等待仍在进行的改进步骤
+class Watchdog
+{
+public:
+    Watchdog(const TimeBudget &budget, Incumbent &incumbent)
+    {
+        if (!budget.limited)
+            return;
+        worker = std::thread([this, &budget, &incumbent]()
+                             {
+                                 std::unique_lock<std::mutex> lock(mutex);
+                                 if (cv.wait_until(lock, budget.flush_at, [this]() { return done; }))
+                                     return;
+                                 lock.unlock();
+                                 if (incumbent.flush())
+                                 {
+                                     std::cerr << "time limit reached, best score: " << incumbent.score() << "\n";
+                                     std::_Exit(0);
+                                 } });
+    }
+
+    ~Watchdog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        cv.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    std::thread worker;
+};
+
+// 在 threads 个线程上执行 fn(t)，线程0即调用线程；其余线程先复制一份调用线程读入的 users / npus。
+// 线程0的 fn(0) 会立即改写调用线程的表(包括时间线节点池的重新分配)，因此先在启动任何线程之前做一份只读快照，
+// 其余线程从快照复制
+template <typename Fn>
+void run_on_threads(int threads, Fn fn)
+{
+    const UserTable input_users = users;
+    const NpuTable input_npus = npus;
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+    {
+        pool.emplace_back([&input_users, &input_npus, &fn, t]()
+                          {
+                              users = input_users;
+                              npus = input_npus;
+                              fn(t); });
+    }
+    fn(0);
+    for (std::thread &th : pool)
+    {
+        th.join();
+    }
+}
+
+// 依次跑 restarts 次随机贪心(限时运行时跑到时间用完为止)，结果提交到 incumbent
+void run_portfolio(uint64_t seed, long long restarts, int threads, double exploration_temperature,
+                   const TimeBudget &budget, Incumbent &incumbent)
+{
+    run_on_threads(threads, [&](int t)
+                   {
+                       IncrementalEvaluator evaluator;
+                       PassResult pass;
+                       Clock::duration slowest_pass{0};
+                       for (int r = 0; static_cast<long long>(r) * threads + t < restarts; ++r)
+                       {
+                           // 第一次贪心必须跑完，之后只在预计能在时限前完成时才开始新的一次
+                           if (r > 0 && !budget.allows(slowest_pass))
+                               break;
+                           Clock::time_point pass_start = Clock::now();
+                           Philox4x32 rng(seed, static_cast<uint32_t>(t), static_cast<uint32_t>(r));
+                           pass.loop_allocations = run_greedy(rng, pass_temperature(t, r, exploration_temperature), pass.solution);
+                           evaluator.build(pass.solution);
+                           pass.score = evaluator.score();
+                           pass.index = static_cast<long long>(r) * threads + t;
+                           pass.thread = t;
+                           pass.restart = r;
+                           incumbent.offer(pass);
+                           slowest_pass = std::max(slowest_pass, Clock::now() - pass_start);
+                       } });
+}
+
+// 流水线规划(见流水线规划一节)并用精确评估器评分；有用户没放下(样本没发完)时方案不合法，得分记为-1，不提交
+PassResult run_pipeline_pass(bool stripe)
+{
+    PassResult pass;
+    plan_pipeline(pass.solution, stripe);
+    IncrementalEvaluator evaluator;
+    evaluator.build(pass.solution);
+    pass.score = evaluator.score();
+    for (int i = 0; i < M; ++i)
+    {
+        if (!evaluator.user_feasible(i))
+        {
+            pass.score = -1;
+            break;
+        }
+    }
+    pass.index = 1LL << 40; // 得分相同时贪心结果优先
+    pass.thread = 0;
+    pass.phase = "pipeline";
+    return pass;
+}
+
+// --- 模拟退火 ---
+// 从当前最优方案出发反复随机修改请求的放置，每一步由 IncrementalEvaluator 只重放受影响的NPU得到新得分:
+// 1. 把一个请求改发到另一个NPU(一半概率选同一用户相邻请求所在的NPU，以减少迁移)
+// 2. 交换两个请求的NPU
+// 3. 在同一用户相邻的两个请求之间挪动样本
+// 只改NPU和B、不改发送时刻，改动须满足显存和发送间隔约束。得分变差 delta 时以 exp(delta / T) 的概率接受，
+// 温度T随进度(限时运行时按时间，否则按步数)从 t0 几何下降到 t1。
+struct AnnealParams
+{
+    double t0 = 10;
+    double t1 = 0.05;
+    long long moves = 1000000; // 不限时运行时每个线程的步数
+};
+
+class Annealer
+{
+public:
+    Annealer(IncrementalEvaluator &evaluator, Philox4x32 &rng) : evaluator(evaluator), rng(rng) {}
+
+    // 退火直到步数用完或超出时间预算；best 为起点方案，结束时为退火过程中得分最高的方案
+    void run(const AnnealParams &params, const TimeBudget &budget, Incumbent &incumbent, PassResult &best)
+    {
+        const Clock::time_point phase_start = Clock::now();
+        const Clock::duration offer_interval = std::chrono::milliseconds(100);
+        Clock::time_point last_offer = phase_start;
+        Clock::time_point last_check = phase_start;
+        bool unoffered = false;
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        double current = evaluator.score();
+        double temperature = params.t0;
+        for (long long step = 0;; ++step)
+        {
+            if ((step & 255) == 0)
+            {
+                double progress;
+                if (budget.limited)
+                {
+                    // 留出两批步数的时间，保证在看门狗写出之前结束
+                    Clock::time_point now = Clock::now();
+                    if (!budget.allows(2 * (now - last_check)))
+                        break;
+                    last_check = now;
+                    progress = std::chrono::duration<double>(now - phase_start).count() /
+                               std::chrono::duration<double>(budget.flush_at - phase_start).count();
+                    if (unoffered && now - last_offer >= offer_interval)
+                    {
+                        PassResult copy = best;
+                        incumbent.offer(copy);
+                        last_offer = now;
+                        unoffered = false;
+                    }
+                }
+                else
+                {
+                    if (step >= params.moves)
+                        break;
+                    progress = static_cast<double>(step) / params.moves;
+                }
+                temperature = params.t0 * std::pow(params.t1 / params.t0, progress);
+            }
+
+            if (!propose())
+                continue;
+            ++evaluated;
+            double delta = evaluator.score() - current;
+            if (delta >= 0 || unit(rng) < std::exp(delta / temperature))
+            {
+                evaluator.commit();
+                current = evaluator.score();
+                if (current > best.score)
+                {
+                    best.score = current;
+                    best.solution = evaluator.solution();
+                    unoffered = true;
+                }
+            }
+            else
+            {
+                evaluator.rollback();
+            }
+        }
+        if (unoffered)
+        {
+            PassResult copy = best;
+            incumbent.offer(copy);
+        }
+    }
+
+    long long evaluated_moves() const { return evaluated; }
+
+private:
+    IncrementalEvaluator &evaluator;
+    Philox4x32 &rng;
+    long long evaluated = 0;
+
+    int random_below(size_t n)
+    {
+        return static_cast<int>(rng() % n);
+    }
+
+    // 随机选一个请求，返回其用户和在用户序列中的位置；用户没有请求时返回false
+    bool pick_request(int &user, int &pos)
+    {
+        user = random_below(M);
+        const std::vector<int> &list = evaluator.requests_of(user);
+        if (list.empty())
+            return false;
+        pos = random_below(list.size());
+        return true;
+    }
+
+    // 用户的第pos个请求以batch B改发到npu后，是否仍满足显存约束以及与下一个请求的发送间隔
+    bool placement_ok(int user, int pos, int npu, int B) const
+    {
+        int server_idx = npus.server_idx[npu];
+        if (B > max_batch_of(server_idx, user))
+            return false;
+        const std::vector<int> &list = evaluator.requests_of(user);
+        if (pos + 1 < static_cast<int>(list.size()) &&
+            evaluator.time_of(list[pos + 1]) < evaluator.time_of(list[pos]) + latency_of(server_idx, user) + 1)
+            return false;
+        return true;
+    }
+
+    // 生成一个可行的改动并作用到评估器上，不可行时不做任何改动并返回false
+    bool propose()
+    {
+        uint32_t kind = rng() % 10;
+        if (kind < 4)
+            return rehome();
+        if (kind < 7)
+            return swap_npus();
+        return shift_samples();
+    }
+
+    bool rehome()
+    {
+        int user, pos;
+        if (!pick_request(user, pos))
+            return false;
+        const std::vector<int> &list = evaluator.requests_of(user);
+        int h = list[pos];
+        int npu;
+        if (list.size() > 1 && rng() % 2 == 0)
+        {
+            int neighbour = pos == 0 ? 1 : (pos + 1 == static_cast<int>(list.size()) || rng() % 2 == 0 ? pos - 1 : pos + 1);
+            npu = evaluator.npu_of(list[neighbour]);
+        }
+        else
+        {
+            npu = random_below(npus.size());
+        }
+        if (npu == evaluator.npu_of(h) || !placement_ok(user, pos, npu, evaluator.batch_of(h)))
+            return false;
+        evaluator.update(h, evaluator.time_of(h), npu, evaluator.batch_of(h));
+        return true;
+    }
+
+    bool swap_npus()
+    {
+        int u1, p1, u2, p2;
+        if (!pick_request(u1, p1) || !pick_request(u2, p2))
+            return false;
+        int h1 = evaluator.requests_of(u1)[p1];
+        int h2 = evaluator.requests_of(u2)[p2];
+        int n1 = evaluator.npu_of(h1), n2 = evaluator.npu_of(h2);
+        if (n1 == n2 || !placement_ok(u1, p1, n2, evaluator.batch_of(h1)) || !placement_ok(u2, p2, n1, evaluator.batch_of(h2)))
+            return false;
+        evaluator.update(h1, evaluator.time_of(h1), n2, evaluator.batch_of(h1));
+        evaluator.update(h2, evaluator.time_of(h2), n1, evaluator.batch_of(h2));
+        return true;
+    }
+
+    bool shift_samples()
+    {
+        int user = random_below(M);
+        const std::vector<int> &list = evaluator.requests_of(user);
+        if (list.size() < 2)
+            return false;
+        int pos = random_below(list.size() - 1);
+        int from = list[pos], to = list[pos + 1];
+        if (rng() % 2 == 0)
+            std::swap(from, to);
+        int from_B = evaluator.batch_of(from), to_B = evaluator.batch_of(to);
+        if (from_B < 2)
+            return false;
+        int amount = 1 + random_below(from_B - 1);
+        if (to_B + amount > max_batch_of(npus.server_idx[evaluator.npu_of(to)], user))
+            return false;
+        evaluator.update(from, evaluator.time_of(from), evaluator.npu_of(from), from_B - amount);
+        evaluator.update(to, evaluator.time_of(to), evaluator.npu_of(to), to_B + amount);
+        return true;
+    }
+};
+
+// 每个线程从当前最优方案出发各自退火，随机流键为 (seed, 线程, ANNEAL_STREAM)
+const uint32_t ANNEAL_STREAM = 0x80000000u;
+
+long long run_annealing(uint64_t seed, int threads, const AnnealParams &params, const TimeBudget &budget, Incumbent &incumbent)
+{
+    PassResult start = incumbent.snapshot();
+    std::vector<long long> evaluated(threads, 0);
+    run_on_threads(threads, [&](int t)
+                   {
+                       PassResult best = start;
+                       best.index = (1LL << 40) + t; // 得分相同时贪心结果优先
+                       best.thread = t;
+                       best.restart = -1;
+                       best.phase = "anneal";
+                       IncrementalEvaluator evaluator;
+                       evaluator.build(best.solution);
+                       Philox4x32 rng(seed, static_cast<uint32_t>(t), ANNEAL_STREAM);
+                       Annealer annealer(evaluator, rng);
+                       annealer.run(params, budget, incumbent, best);
+                       evaluated[t] = annealer.evaluated_moves(); });
+    return std::accumulate(evaluated.begin(), evaluated.end(), 0LL);
+}
+
+// --- 束搜索 ---
+// 每步保留估计得分最高的 W 个部分方案，每个部分方案取成本函数给出的成本最低的 C 个候选各扩展一步。
+// 估计得分按题面公式计算: 已排完的用户用调度器NPU模型下的完成时刻，未排完的用户做乐观估计
+// (在最快的服务器上按最大batch背靠背发送，不考虑NPU竞争)，超时用户数同样按估计值计入 h(K)。
+// 部分方案共享结构: 用户状态和NPU状态按块放在 shared_ptr 中，扩展时只复制被修改的块(写时复制)，
+// 决策序列存为父指针树；候选先只算估计得分，入选后才真正生成状态。最后用精确评估器给完整方案打分。
+const int BEAM_BLOCK = 32;
+
+struct BeamUserBlock
+{
+    int remaining[BEAM_BLOCK] = {};
+    long long next_send_time[BEAM_BLOCK] = {};
+    int last_npu[BEAM_BLOCK] = {};
+    int last_server_idx[BEAM_BLOCK] = {};
+    int sent[BEAM_BLOCK] = {};
+    int moves[BEAM_BLOCK] = {};
+    long long end[BEAM_BLOCK] = {}; // 已发请求的最晚完成时刻
+    double term[BEAM_BLOCK] = {};   // 得分项，未排完时为估计值
+    bool late[BEAM_BLOCK] = {};
+    long long min_send_time = 0;    // 块内未排完用户的最早发送时刻
+
+    void refresh_min()
+    {
+        min_send_time = std::numeric_limits<long long>::max();
+        for (int k = 0; k < BEAM_BLOCK; ++k)
+        {
+            if (remaining[k] > 0)
+                min_send_time = std::min(min_send_time, next_send_time[k]);
+        }
+    }
+};
+
+struct BeamNpuBlock
+{
+    long long free_at[BEAM_BLOCK] = {};
+    long long utilization_time[BEAM_BLOCK] = {};
+};
+
+struct BeamState
+{
+    std::vector<std::shared_ptr<BeamUserBlock>> user_blocks;
+    std::vector<std::shared_ptr<BeamNpuBlock>> npu_blocks;
+    int decision = -1; // 最后一个决策在决策树中的下标
+    long long remaining_total = 0;
+    long long utilization_sum = 0;
+    double term_sum = 0;
+    int late = 0;
+
+    double score() const
+    {
+        return std::pow(2.0, -late / 100.0) * term_sum * 10000;
+    }
+
+    const BeamUserBlock &user_block(int u) const { return *user_blocks[u / BEAM_BLOCK]; }
+    const BeamNpuBlock &npu_block(int j) const { return *npu_blocks[j / BEAM_BLOCK]; }
+
+    // 写时复制: 块被其他状态共享时先复制一份
+    BeamUserBlock &mutable_user_block(int u)
+    {
+        std::shared_ptr<BeamUserBlock> &block = user_blocks[u / BEAM_BLOCK];
+        if (block.use_count() > 1)
+            block = std::make_shared<BeamUserBlock>(*block);
+        return *block;
+    }
+
+    BeamNpuBlock &mutable_npu_block(int j)
+    {
+        std::shared_ptr<BeamNpuBlock> &block = npu_blocks[j / BEAM_BLOCK];
+        if (block.use_count() > 1)
+            block = std::make_shared<BeamNpuBlock>(*block);
+        return *block;
+    }
+};
+
+struct BeamParams
+{
+    int width = 32;  // 保留的部分方案数 W
+    int expand = 4;  // 每个部分方案扩展的候选数 C
+};
+
+class BeamSearch
+{
+public:
+    explicit BeamSearch(const BeamParams &params) : params(params) {}
+
+    // 搜索完整方案，超出时间预算时放弃并返回false
+    bool run(const TimeBudget &budget, Solution &solution, double &score)
+    {
+        std::vector<BeamState> beam(1, initial_state());
+        std::vector<BeamState> next, finished;
+        while (!beam.empty())
+        {
+            if (!budget.allows(Clock::duration::zero()))
+                return false;
+
+            candidates.clear();
+            for (size_t idx = 0; idx < beam.size(); ++idx)
+            {
+                expand(static_cast<int>(idx), beam[idx]);
+            }
+            size_t keep = std::min(candidates.size(), static_cast<size_t>(params.width));
+            std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(), [](const Candidate &x, const Candidate &y)
+                              {
+                                  if (x.score != y.score)
+                                      return x.score > y.score;
+                                  if (x.state != y.state)
+                                      return x.state < y.state;
+                                  return x.cost < y.cost; });
+
+            next.clear();
+            for (size_t idx = 0; idx < keep; ++idx)
+            {
+                BeamState child = beam[candidates[idx].state];
+                apply(child, candidates[idx]);
+                if (child.remaining_total == 0)
+                    finished.push_back(std::move(child));
+                else
+                    next.push_back(std::move(child));
+            }
+            beam.swap(next);
+
+            // 完整方案只保留估计得分最高的 W 个
+            if (finished.size() > static_cast<size_t>(params.width))
+            {
+                std::sort(finished.begin(), finished.end(), [](const BeamState &x, const BeamState &y)
+                          { return x.score() > y.score(); });
+                finished.resize(params.width);
+            }
+        }
+
+        // 用精确评估器挑出最好的完整方案
+        score = -1;
+        IncrementalEvaluator evaluator;
+        Solution candidate;
+        for (const BeamState &state : finished)
+        {
+            extract(state, candidate);
+            evaluator.build(candidate);
+            if (evaluator.score() > score)
+            {
+                score = evaluator.score();
+                solution.swap(candidate);
+            }
+        }
+        return !finished.empty();
+    }
+
+private:
+    struct Decision
+    {
+        int parent;
+        int user;
+        long long time;
+        int npu;
+        int B;
+    };
+
+    // 一个尚未生成的子状态: 在第 state 个部分方案上把 user 调度到 npu
+    struct Candidate
+    {
+        int state;
+        int user;
+        int npu;
+        int B;
+        long long finish;
+        long long cost;
+        double score;
+    };
+
+    BeamParams params;
+    std::vector<Decision> decisions;
+    std::vector<Candidate> candidates;
+    std::vector<Candidate> local; // 单个部分方案的候选
+    std::vector<int> ready;
+
+    BeamState initial_state()
+    {
+        BeamState state;
+        int user_blocks = (M + BEAM_BLOCK - 1) / BEAM_BLOCK;
+        int npu_blocks = (static_cast<int>(npus.size()) + BEAM_BLOCK - 1) / BEAM_BLOCK;
+        for (int b = 0; b < user_blocks; ++b)
+            state.user_blocks.push_back(std::make_shared<BeamUserBlock>());
+        for (int b = 0; b < npu_blocks; ++b)
+            state.npu_blocks.push_back(std::make_shared<BeamNpuBlock>());
+        for (int u = 0; u < M; ++u)
+        {
+            BeamUserBlock &block = *state.user_blocks[u / BEAM_BLOCK];
+            int k = u % BEAM_BLOCK;
+            block.remaining[k] = users.cnt[u];
+            block.next_send_time[k] = users.s[u];
+            block.last_npu[k] = -1;
+            block.last_server_idx[k] = -1;
+            block.term[k] = estimate(u, users.cnt[u], users.s[u], 0, 0, block.late[k]);
+            state.remaining_total += users.cnt[u];
+            state.term_sum += block.term[k];
+            state.late += block.late[k];
+        }
+        for (auto &block : state.user_blocks)
+            block->refresh_min();
+        return state;
+    }
+
+    // 用户u的得分项: 未排完时按最快服务器背靠背发送最大batch乐观估计完成时刻
+    double estimate(int u, int remaining, long long next_send_time, long long end, int moves, bool &late) const
+    {
+        long long finish = end;
+        if (remaining > 0)
+        {
+            long long best = std::numeric_limits<long long>::max();
+            for (int server_idx = 0; server_idx < N; ++server_idx)
+            {
+                int max_b = std::min(max_batch_of(server_idx, u), remaining);
+                if (max_b <= 0)
+                    continue;
+                long long requests = (remaining + max_b - 1) / max_b;
+                int latency = latency_of(server_idx, u);
+                best = std::min(best, next_send_time + (requests - 1) * (latency + 1) + latency +
+                                          calculate_inference_time(max_b, servers[server_idx].k));
+            }
+            finish = std::max(finish, best);
+        }
+        late = finish > users.e[u];
+        double lateness = static_cast<double>(finish - users.e[u]) / (users.e[u] - users.s[u]);
+        return std::pow(2.0, -lateness / 100.0) * std::pow(2.0, -moves / 200.0);
+    }
+
+    // 收集部分方案的最优C个候选；所有就绪用户都无法调度时按贪心的死循环处理推进时间后重试
+    void expand(int index, BeamState &state)
+    {
+        for (;;)
+        {
+            long long current_time = std::numeric_limits<long long>::max();
+            for (const auto &block : state.user_blocks)
+                current_time = std::min(current_time, block->min_send_time);
+
+            ready.clear();
+            for (size_t b = 0; b < state.user_blocks.size(); ++b)
+            {
+                const BeamUserBlock &block = *state.user_blocks[b];
+                if (block.min_send_time != current_time)
+                    continue;
+                for (int k = 0; k < BEAM_BLOCK; ++k)
+                {
+                    if (block.remaining[k] > 0 && block.next_send_time[k] == current_time)
+                        ready.push_back(static_cast<int>(b) * BEAM_BLOCK + k);
+                }
+            }
+
+            local.clear();
+            for (int u : ready)
+            {
+                const BeamUserBlock &block = state.user_block(u);
+                int k = u % BEAM_BLOCK;
+                long long remaining_time = std::max(1LL, users.e[u] - current_time);
+                UserCostState user{block.next_send_time[k], static_cast<double>(block.remaining[k]) / remaining_time,
+                                   block.last_npu[k], block.last_server_idx[k], block.sent[k]};
+                for (int server_idx = 0; server_idx < N; ++server_idx)
+                {
+                    BatchTerm term = make_batch_term(u, server_idx, block.remaining[k], block.sent[k]);
+                    if (term.optimal_B <= 0)
+                        continue;
+                    int first = server_npu_offset[server_idx];
+                    for (int j = first; j < first + servers[server_idx].g; ++j)
+                    {
+                        const BeamNpuBlock &npu_block = state.npu_block(j);
+                        NpuCostState npu{nullptr, npu_block.free_at[j % BEAM_BLOCK], npu_block.utilization_time[j % BEAM_BLOCK], state.utilization_sum};
+                        Candidate c{index, u, j, 0, 0, 0, 0.0};
+                        c.cost = decision_cost(u, j, current_time, term, user, npu, c.B, c.finish);
+                        if (c.cost != std::numeric_limits<long long>::max())
+                            local.push_back(c);
+                    }
+                }
+            }
+
+            if (!local.empty())
+                break;
+            if (!advance_stuck_users(state, current_time))
+                return; // 无法继续，丢弃该部分方案
+        }
+
+        size_t keep = std::min(local.size(), static_cast<size_t>(params.expand));
+        std::partial_sort(local.begin(), local.begin() + keep, local.end(), [](const Candidate &x, const Candidate &y)
+                          { return x.cost != y.cost ? x.cost < y.cost : (x.user != y.user ? x.user < y.user : x.npu < y.npu); });
+        for (size_t idx = 0; idx < keep; ++idx)
+        {
+            Candidate &c = local[idx];
+            const BeamUserBlock &block = state.user_block(c.user);
+            int k = c.user % BEAM_BLOCK;
+            bool late;
+            int moves = block.moves[k] + (block.last_npu[k] != -1 && block.last_npu[k] != c.npu);
+            int server_idx = npus.server_idx[c.npu];
+            double term = estimate(c.user, block.remaining[k] - c.B, block.next_send_time[k] + latency_of(server_idx, c.user) + 1,
+                                   std::max(block.end[k], c.finish), moves, late);
+            c.score = std::pow(2.0, -(state.late - block.late[k] + late) / 100.0) * (state.term_sum - block.term[k] + term) * 10000;
+            candidates.push_back(c);
+        }
+    }
+
+    // 贪心的死循环处理: 把就绪用户推进到下一个NPU释放时刻
+    bool advance_stuck_users(BeamState &state, long long current_time)
+    {
+        long long next_event = std::numeric_limits<long long>::max();
+        for (size_t j = 0; j < npus.size(); ++j)
+        {
+            long long free_at = state.npu_block(static_cast<int>(j)).free_at[j % BEAM_BLOCK];
+            if (free_at > current_time)
+                next_event = std::min(next_event, free_at);
+        }
+        if (next_event == std::numeric_limits<long long>::max() || ready.empty())
+            return false;
+        for (int u : ready)
+        {
+            BeamUserBlock &block = state.mutable_user_block(u);
+            block.next_send_time[u % BEAM_BLOCK] = next_event;
+            block.refresh_min();
+        }
+        return true;
+    }
+
+    void apply(BeamState &state, const Candidate &c)
+    {
+        BeamUserBlock &block = state.mutable_user_block(c.user);
+        BeamNpuBlock &npu_block = state.mutable_npu_block(c.npu);
+        int k = c.user % BEAM_BLOCK;
+        int j = c.npu % BEAM_BLOCK;
+        int server_idx = npus.server_idx[c.npu];
+        long long send_time = block.next_send_time[k];
+        int latency = latency_of(server_idx, c.user);
+
+        decisions.push_back({state.decision, c.user, send_time, c.npu, c.B});
+        state.decision = static_cast<int>(decisions.size()) - 1;
+
+        if (block.last_npu[k] != -1 && block.last_npu[k] != c.npu)
+            ++block.moves[k];
+        block.remaining[k] -= c.B;
+        block.sent[k] += 1;
+        block.last_npu[k] = c.npu;
+        block.last_server_idx[k] = server_idx;
+        block.next_send_time[k] = send_time + latency + 1;
+        block.end[k] = std::max(block.end[k], c.finish);
+        state.remaining_total -= c.B;
+
+        bool late;
+        double term = estimate(c.user, block.remaining[k], block.next_send_time[k], block.end[k], block.moves[k], late);
+        state.term_sum += term - block.term[k];
+        state.late += late - block.late[k];
+        block.term[k] = term;
+        block.late[k] = late;
+        block.refresh_min();
+
+        long long inference_time = c.finish - std::max(send_time + latency, npu_block.free_at[j]);
+        npu_block.free_at[j] = c.finish;
+        npu_block.utilization_time[j] += inference_time;
+        state.utilization_sum += inference_time;
+    }
+
+    // 沿决策树还原完整方案
+    void extract(const BeamState &state, Solution &solution) const
+    {
+        solution.assign(M, {});
+        for (int d = state.decision; d != -1; d = decisions[d].parent)
+        {
+            const Decision &decision = decisions[d];
+            solution[decision.user].push_back({decision.user + 1, decision.time, npus.server_idx[decision.npu] + 1,
+                                               npus.id_in_server[decision.npu], decision.B});
+        }
+        for (auto &requests : solution)
+            std::reverse(requests.begin(), requests.end());
+    }
+};
+
+// --- 大邻域搜索 ---
+// 每轮从当前方案中拆掉一组相关用户的全部请求，其余用户的请求原样保留、作为NPU上的既有负载，
+// 再用贪心的成本函数(run_greedy 的 pinned 模式)重新调度这组用户；精确得分提高时接受新方案。
+// 相关用户按三种方式轮流选取:
+// 1. 共享NPU: 随机选一个NPU(有超时用户时一半概率选超时用户用过的NPU)，取在该NPU上有请求的用户
+// 2. 时间窗重叠: 随机选一个用户，取 [s, e) 与其重叠、起始时刻最接近的用户
+// 3. 超时用户: 当前所有超时用户，不足时按共享NPU补足；没有超时用户时退化为方式1
+struct LnsParams
+{
+    int users = 12;                // 每轮拆掉的用户数
+    long long iterations = 200;    // 不限时运行时每个线程的轮数
+    double temperature = 1e-3;     // 重新调度时的采样温度
+};
+
+class NeighbourhoodSelector
+{
+public:
+    NeighbourhoodSelector(const IncrementalEvaluator &evaluator, Philox4x32 &rng)
+        : evaluator(evaluator), rng(rng), chosen_mark(M, 0) {}
+
+    // 按第 kind 种方式选出最多 size 个相关用户
+    const std::vector<int> &select(int kind, int size)
+    {
+        for (int u : chosen)
+            chosen_mark[u] = 0;
+        chosen.clear();
+        late.clear();
+        for (int u = 0; u < M; ++u)
+        {
+            if (evaluator.end_of(u) > users.e[u])
+                late.push_back(u);
+        }
+
+        if (kind == 1)
+        {
+            by_window(size);
+        }
+        else if (kind == 2 && !late.empty())
+        {
+            shuffle(late);
+            for (size_t idx = 0; idx < late.size() && static_cast<int>(chosen.size()) < size; ++idx)
+                add(late[idx]);
+            while (static_cast<int>(chosen.size()) < size && by_npu(size))
+            {
+            }
+        }
+        else
+        {
+            by_npu(size);
+        }
+        return chosen;
+    }
+
+private:
+    const IncrementalEvaluator &evaluator;
+    Philox4x32 &rng;
+    std::vector<char> chosen_mark;
+    std::vector<int> chosen, late, candidates;
+
+    int random_below(size_t n)
+    {
+        return static_cast<int>(rng() % n);
+    }
+
+    void shuffle(std::vector<int> &list)
+    {
+        for (size_t idx = list.size(); idx > 1; --idx)
+            std::swap(list[idx - 1], list[random_below(idx)]);
+    }
+
+    void add(int u)
+    {
+        if (!chosen_mark[u])
+        {
+            chosen_mark[u] = 1;
+            chosen.push_back(u);
+        }
+    }
+
+    // 从一个NPU上补充用户，返回是否加入了新用户
+    bool by_npu(int size)
+    {
+        int seed_user = !late.empty() && rng() % 2 == 0 ? late[random_below(late.size())] : random_below(M);
+        const std::vector<int> &list = evaluator.requests_of(seed_user);
+        if (list.empty())
+            return false;
+        int npu = evaluator.npu_of(list[random_below(list.size())]);
+        candidates.clear();
+        for (int h : evaluator.jobs_on(npu))
+        {
+            int u = evaluator.request(h).user_id - 1;
+            if (!chosen_mark[u] && std::find(candidates.begin(), candidates.end(), u) == candidates.end())
+                candidates.push_back(u);
+        }
+        shuffle(candidates);
+        size_t before = chosen.size();
+        for (size_t idx = 0; idx < candidates.size() && static_cast<int>(chosen.size()) < size; ++idx)
+            add(candidates[idx]);
+        return chosen.size() > before;
+    }
+
+    void by_window(int size)
+    {
+        int centre = random_below(M);
+        candidates.clear();
+        for (int u = 0; u < M; ++u)
+        {
+            if (users.s[u] < users.e[centre] && users.s[centre] < users.e[u])
+                candidates.push_back(u);
+        }
+        auto distance = [centre](int u)
+        {
+            return std::abs(users.s[u] - users.s[centre]);
+        };
+        size_t take = std::min(candidates.size(), static_cast<size_t>(size));
+        std::partial_sort(candidates.begin(), candidates.begin() + take, candidates.end(), [&](int x, int y)
+                          { return distance(x) != distance(y) ? distance(x) < distance(y) : x < y; });
+        for (size_t idx = 0; idx < take; ++idx)
+            add(candidates[idx]);
+    }
+};
+
+// 每个线程从当前最优方案出发各自做大邻域搜索，随机流键为 (seed, 线程, LNS_STREAM)
+const uint32_t LNS_STREAM = 0x80000001u;
+
+long long run_lns(uint64_t seed, int threads, const LnsParams &params, const TimeBudget &budget, Incumbent &incumbent)
+{
+    PassResult start = incumbent.snapshot();
+    std::vector<long long> accepted(threads, 0);
+    run_on_threads(threads, [&](int t)
+                   {
+                       PassResult best = start;
+                       best.index = (1LL << 40) + t; // 得分相同时贪心结果优先
+                       best.thread = t;
+                       best.restart = -1;
+                       best.phase = "lns";
+                       IncrementalEvaluator evaluator;
+                       evaluator.build(best.solution);
+                       Philox4x32 rng(seed, static_cast<uint32_t>(t), LNS_STREAM);
+                       NeighbourhoodSelector selector(evaluator, rng);
+                       Solution pinned, candidate;
+                       Clock::duration slowest_round{0};
+                       for (long long round = 0; budget.limited || round < params.iterations; ++round)
+                       {
+                           if (!budget.allows(slowest_round))
+                               break;
+                           Clock::time_point round_start = Clock::now();
+                           const std::vector<int> &chosen = selector.select(static_cast<int>(round % 3), params.users);
+                           pinned = best.solution;
+                           for (int u : chosen)
+                               pinned[u].clear();
+                           run_greedy(rng, params.temperature, candidate, &pinned);
+
+                           // 贪心没能排完全部样本时放弃这一轮
+                           bool complete = true;
+                           for (int u : chosen)
+                               complete = complete && users.remaining_cnt[u] == 0;
+                           if (complete)
+                           {
+                               IncrementalEvaluator trial;
+                               trial.build(candidate);
+                               if (trial.score() > best.score)
+                               {
+                                   best.score = trial.score();
+                                   best.solution.swap(candidate);
+                                   evaluator.build(best.solution);
+                                   PassResult copy = best;
+                                   incumbent.offer(copy);
+                                   ++accepted[t];
+                               }
+                           }
+                           slowest_round = std::max(slowest_round, Clock::now() - round_start);
+                       } });
+    return std::accumulate(accepted.begin(), accepted.end(), 0LL);
+}
+
+// --- 精确求解(分支定界) ---
+// 用于测量启发式的最优性差距，只适合 generate.py 的小规模数据(2个服务器、10个用户)这样的极小实例。
+// 搜索覆盖所有合法方案: 时钟从最早的 s 起逐毫秒推进，当前时刻可以发送的用户按编号依次决定本毫秒是否发送；
+// 发送时枚举NPU和所有合法的batch(不超过剩余样本和显存上限，且剩余样本还能在300个请求内发完)，不发送时推迟到下一毫秒。
+// 部分方案由 IncrementalEvaluator 逐个插入/删除请求精确回放，叶子直接取它的得分。
+// 上界: 不考虑其他用户的竞争时，用户完成剩余样本的最早时刻可以用动态规划精确求出(状态为剩余样本数、
+// 上一个请求所在的服务器、还允许的迁移次数，batch任取)；已发出的请求不早于到达加推理耗时完成。每个用户的得分项取
+// 各迁移次数下的最大值，必然超时的用户计入K，得到可采纳的上界。推迟发送只会降低上界，发送时刻的范围由它限定。
+// 同一服务器上尚未使用的NPU互相等价，分支时每个服务器只尝试其中编号最小的一个。
+// 置换表: 时钟推进到 T 时，之后的请求最早在 T+最小时延 到达，在此之前开始推理的请求的完成时刻已经确定。
+// 状态取 (T; 每个用户的剩余样本数、最早发送时刻、上一个NPU、迁移次数、已发请求数、已确定的完成时刻;
+// 每个NPU上仍在推理的请求的(完成时刻, 显存)与尚未开始推理的请求的(到达时刻, 用户, batch))，它决定之后所有方案的得分。
+// 访问过的状态再次出现时直接返回: 第一次访问时剪掉的分支，上界不超过当时的、因而也不超过现在的最优值。
+// 节点上限内搜索完即证明最优；当前最优达到根的上界时所有分支都被剪掉，立即结束。
+struct ExactParams
+{
+    long long node_limit = 20000000; // 搜索节点上限，超过时停止并报告当前最优与上界
+};
+
+const int EXACT_MAX_USERS = 20;
+const int EXACT_MOVE_LEVELS = 3;                    // 动态规划区分迁移0..2次，第3层表示不限迁移次数
+const double EXACT_PRUNE_EPS = 1e-9;                // 上界不超过当前最优的(1+EPS)倍即剪枝
+const long long EXACT_MAX_SEND_TIME = 1000000;      // 输出约束: 发送时刻不超过1e6
+const int EXACT_MAX_DEPTH = 20000;                  // 递归深度上限，超过时与节点上限一样停止
+const size_t EXACT_TABLE_BYTES = size_t(256) << 20; // 置换表的内存上限，满了以后只查不插
+
+class ExactSolver
+{
+public:
+    explicit ExactSolver(const ExactParams &params) : params(params) {}
+
+    // 从已有方案 start 出发搜索，返回是否在节点上限内证明了最优；best 为最优方案(可能就是 start)
+    bool run(const PassResult &start, Solution &best, double &best_score)
+    {
+        build_tables();
+
+        min_latency = std::numeric_limits<int>::max();
+        max_b_any.assign(M, 0);
+        for (int i = 0; i < M; ++i)
+        {
+            for (int s = 0; s < N; ++s)
+            {
+                min_latency = std::min(min_latency, latency_of(s, i));
+                max_b_any[i] = std::max(max_b_any[i], max_batch_of(s, i));
+            }
+        }
+
+        remaining.assign(M, 0);
+        next_send.assign(M, 0);
+        last_npu.assign(M, -1);
+        moves.assign(M, 0);
+        sent.assign(M, 0);
+        committed_end.assign(M, 0);
+        term.assign(M, 0);
+        late.assign(M, 0);
+        npu_jobs.assign(npus.size(), 0);
+        npu_free.assign(npus.size(), 0);
+        current.assign(M, {});
+        evaluator.build(current);
+        term_sum = 0;
+        late_count = 0;
+        clock = std::numeric_limits<long long>::max();
+        for (int i = 0; i < M; ++i)
+        {
+            remaining[i] = users.cnt[i];
+            next_send[i] = users.s[i];
+            clock = std::min(clock, next_send[i]);
+            bool is_late = false;
+            term[i] = user_bound(i, remaining[i], next_send[i], -1, 0, 0, is_late);
+            late[i] = is_late;
+            term_sum += term[i];
+            late_count += late[i];
+        }
+        root_bound = total_bound(late_count, term_sum);
+
+        best_solution = start.solution;
+        this->best_score = start.score;
+        search(0);
+        best.swap(best_solution);
+        best_score = this->best_score;
+        return !aborted;
+    }
+
+    long long nodes() const { return node_count; }
+    double bound() const { return root_bound; }
+
+private:
+    static constexpr int INF = std::numeric_limits<int>::max() / 2;
+
+    struct Child
+    {
+        double bound;
+        long long free_at;
+        int npu; // -1 表示本毫秒不发送
+        int B;
+    };
+
+    size_t slot(int user, int level, int sigma, int r) const
+    {
+        return (static_cast<size_t>(level) * (N + 1) + sigma) * (users.cnt[user] + 1) + r;
+    }
+
+    // chain[u] 按 [迁移层][上一个服务器+1][剩余样本数] 平铺，值为从发送下一个请求起到最后一个样本完成的最短时间
+    void build_tables()
+    {
+        chain.assign(M, {});
+        for (int u = 0; u < M; ++u)
+        {
+            int cnt = users.cnt[u];
+            std::vector<int> &g = chain[u];
+            g.assign(static_cast<size_t>(EXACT_MOVE_LEVELS + 1) * (N + 1) * (cnt + 1), INF);
+            for (int level = 0; level <= EXACT_MOVE_LEVELS; ++level)
+            {
+                for (int sigma = 0; sigma <= N; ++sigma)
+                    g[slot(u, level, sigma, 0)] = 0;
+            }
+            for (int r = 1; r <= cnt; ++r)
+            {
+                for (int level = 0; level <= EXACT_MOVE_LEVELS; ++level)
+                {
+                    for (int sigma = 0; sigma <= N; ++sigma)
+                    {
+                        int best_tail = INF;
+                        for (int s = 0; s < N; ++s)
+                        {
+                            int max_b = max_batch_of(s, u);
+                            if (max_b <= 0)
+                                continue;
+                            int next_level = level;
+                            if (sigma != 0 && sigma != s + 1 && level < EXACT_MOVE_LEVELS)
+                                next_level = level - 1;
+                            if (next_level < 0)
+                                continue;
+                            int latency = latency_of(s, u);
+                            for (int B = 1; B <= std::min(r, max_b); ++B)
+                            {
+                                int finish = latency + calculate_inference_time(B, servers[s].k);
+                                int tail = finish;
+                                if (B < r)
+                                {
+                                    int rest = g[slot(u, next_level, s + 1, r - B)];
+                                    if (rest >= INF)
+                                        continue;
+                                    tail = std::max(finish, latency + 1 + rest);
+                                }
+                                best_tail = std::min(best_tail, tail);
+                            }
+                        }
+                        g[slot(u, level, sigma, r)] = best_tail;
+                    }
+                }
+            }
+        }
+    }
+
+    static double term_of(int user, long long end, int move_count)
+    {
+        double lateness = static_cast<double>(end - users.e[user]) / (users.e[user] - users.s[user]);
+        return std::pow(2.0, -lateness / 100.0) * std::pow(2.0, -move_count / 200.0);
+    }
+
+    static double total_bound(int late_users, double terms)
+    {
+        return std::pow(2.0, -late_users / 100.0) * terms * 10000;
+    }
+
+    // 用户在给定状态下得分项的上界；is_late 表示即使不限迁移也必然超时
+    double user_bound(int u, int r, long long send, int last, int move_count, long long end_so_far, bool &is_late) const
+    {
+        if (r == 0)
+        {
+            is_late = end_so_far > users.e[u];
+            return term_of(u, end_so_far, move_count);
+        }
+        int sigma = last < 0 ? 0 : npus.server_idx[last] + 1;
+        double best = 0;
+        long long earliest = std::numeric_limits<long long>::max();
+        for (int level = 0; level <= EXACT_MOVE_LEVELS; ++level)
+        {
+            int tail = chain[u][slot(u, level, sigma, r)];
+            if (tail >= INF)
+                continue;
+            long long end = std::max(end_so_far, send + tail);
+            earliest = std::min(earliest, end);
+            best = std::max(best, term_of(u, end, move_count + level));
+        }
+        is_late = earliest > users.e[u];
+        return best;
+    }
+
+    // 用户 u 的状态改变后刷新它的上界项，恢复时由调用方还原 term / late / term_sum / late_count
+    void refresh_term(int u)
+    {
+        bool is_late = false;
+        double bound = user_bound(u, remaining[u], next_send[u], last_npu[u], moves[u], committed_end[u], is_late);
+        term_sum += bound - term[u];
+        late_count += is_late - late[u];
+        term[u] = bound;
+        late[u] = is_late;
+    }
+
+    void put(long long value)
+    {
+        int32_t v = static_cast<int32_t>(value);
+        key.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    // 时钟推进后查置换表，状态第一次出现时记下并返回 true
+    bool visit_state()
+    {
+        key.clear();
+        put(clock);
+        long long horizon = clock + min_latency;
+        fixed_end.assign(M, 0);
+        for (size_t n = 0; n < npus.size(); ++n)
+        {
+            const std::vector<int> &jobs = evaluator.jobs_on(static_cast<int>(n));
+            int k = servers[npus.server_idx[n]].k;
+            running.clear();
+            size_t pending_at = key.size();
+            put(0);
+            int pending = 0;
+            for (int h : jobs)
+            {
+                ScheduledRequest r = evaluator.request(h);
+                int user = r.user_id - 1;
+                long long finish = evaluator.finish_of(h);
+                if (finish - calculate_inference_time(r.B, k) < horizon)
+                {
+                    fixed_end[user] = std::max(fixed_end[user], finish);
+                    if (finish > horizon)
+                        running.push_back({finish, users.a[user] * r.B + users.b[user]});
+                }
+                else
+                {
+                    // jobs 按 (到达时刻, 用户) 有序，即队列顺序
+                    put(r.time + latency_of(npus.server_idx[n], user));
+                    put(user);
+                    put(r.B);
+                    ++pending;
+                }
+            }
+            int32_t count = pending;
+            std::memcpy(&key[pending_at], &count, sizeof(count));
+            std::sort(running.begin(), running.end());
+            put(static_cast<long long>(running.size()));
+            for (const auto &job : running)
+            {
+                put(job.first);
+                put(job.second);
             }
         }
+        for (int i = 0; i < M; ++i)
+        {
+            put(remaining[i]);
+            put(next_send[i]);
+            put(last_npu[i]);
+            put(moves[i]);
+            put(sent[i]);
+            put(fixed_end[i]);
+        }
+        if (visited.count(key))
+            return false;
+        if (table_bytes < EXACT_TABLE_BYTES)
+        {
+            table_bytes += key.size() + sizeof(std::string) + 2 * sizeof(void *);
+            visited.insert(key);
+        }
+        return true;
+    }
 
-        if (!valid_options.empty())
+    void search(int depth)
+    {
+        if (++node_count > params.node_limit || depth > EXACT_MAX_DEPTH)
         {
-            // 方法：稀疏矩阵自适应概率分布，专门处理大量INF + 少数负值的情况
+            aborted = true;
+            return;
+        }
+        // 当前时刻可以发送的用户中编号最小的一个做决定
+        int u = -1;
+        long long next_clock = std::numeric_limits<long long>::max();
+        for (int i = 0; i < M && u < 0; ++i)
+        {
+            if (remaining[i] == 0)
+                continue;
+            if (next_send[i] <= clock)
+                u = i;
+            else
+                next_clock = std::min(next_clock, next_send[i]);
+        }
+        if (u < 0)
+        {
+            if (next_clock == std::numeric_limits<long long>::max())
+            {
+                if (evaluator.score() > best_score)
+                {
+                    best_score = evaluator.score();
+                    best_solution = current;
+                }
+                return;
+            }
+            long long saved_clock = clock;
+            clock = next_clock;
+            if (visit_state())
+                search(depth + 1);
+            clock = saved_clock;
+            return;
+        }
 
-            std::vector<double> probabilities(valid_options.size());
-            double sum_exp = 0.0;
+        std::vector<Child> children;
+        double others = term_sum - term[u];
+        int others_late = late_count - late[u];
+        auto total = [&](double bound, bool is_late)
+        { return total_bound(others_late + is_late, others + bound); };
+        double threshold = best_score * (1 + EXACT_PRUNE_EPS);
+
+        int r = remaining[u];
+        // 发出这个请求后最多还能再发 299-sent 个
+        long long later = static_cast<long long>(300 - 1 - sent[u]) * max_b_any[u];
+        int min_B = static_cast<int>(std::max(1LL, r - later));
+        for (int s = 0; s < N; ++s)
+        {
+            int max_b = std::min(r, max_batch_of(s, u));
+            if (max_b < min_B)
+                continue;
+            int latency = latency_of(s, u);
+            long long arrival = clock + latency;
+            int first = server_npu_offset[s];
+            for (int B = max_b; B >= min_B; --B)
+            {
+                if (B < r && arrival + 1 > EXACT_MAX_SEND_TIME)
+                    continue; // 之后不能再发送，只能一次发完
+                long long end = std::max(committed_end[u], arrival + calculate_inference_time(B, servers[s].k));
+                // 上界只与迁移次数有关: 留在上一个NPU或换到本服务器的其他NPU
+                double stay = -1, moved = -1;
+                bool untouched_tried = false;
+                for (int j = 0; j < servers[s].g; ++j)
+                {
+                    int n = first + j;
+                    if (npu_jobs[n] == 0)
+                    {
+                        if (untouched_tried)
+                            continue;
+                        untouched_tried = true;
+                    }
+                    bool move = last_npu[u] >= 0 && last_npu[u] != n;
+                    double &cached = move ? moved : stay;
+                    if (cached < 0)
+                    {
+                        bool is_late = false;
+                        double bound = user_bound(u, r - B, arrival + 1, n, moves[u] + move, end, is_late);
+                        cached = total(bound, is_late);
+                    }
+                    if (cached > threshold)
+                        children.push_back({cached, std::max(npu_free[n], arrival), n, B});
+                }
+            }
+        }
+        if (clock + 1 <= EXACT_MAX_SEND_TIME)
+        {
+            bool is_late = false;
+            double bound = user_bound(u, r, clock + 1, last_npu[u], moves[u], committed_end[u], is_late);
+            if (total(bound, is_late) > threshold)
+                children.push_back({total(bound, is_late), std::numeric_limits<long long>::max(), -1, 0});
+        }
+        std::sort(children.begin(), children.end(), [](const Child &x, const Child &y)
+                  {
+                      if (x.bound != y.bound)
+                          return x.bound > y.bound;
+                      if (x.free_at != y.free_at)
+                          return x.free_at < y.free_at;
+                      return x.npu != y.npu ? x.npu < y.npu : x.B > y.B; });
 
-            if (valid_options.size() == 1)
+        for (const Child &child : children)
+        {
+            if (child.bound <= best_score * (1 + EXACT_PRUNE_EPS))
+                break;
+            long long saved_send = next_send[u];
+            double saved_term = term[u], saved_sum = term_sum;
+            int saved_late = late[u], saved_count = late_count;
+            if (child.npu < 0)
             {
-                // 只有一个有效选项，直接选择
-                probabilities[0] = 1.0;
-                sum_exp = 1.0;
+                next_send[u] = clock + 1;
+                refresh_term(u);
+                search(depth + 1);
+                next_send[u] = saved_send;
             }
-            else if (valid_options.size() <= 50)
+            else
             {
-                // 有效选项很少时，使用改进的排名法，给更多探索机会
-                std::vector<size_t> indices(valid_options.size());
-                std::iota(indices.begin(), indices.end(), 0);
+                // 记下用户和NPU的状态，递归后恢复
+                int saved_remaining = remaining[u], saved_last = last_npu[u], saved_moves = moves[u];
+                long long saved_end = committed_end[u], saved_free = npu_free[child.npu];
 
-                std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b)
-                          { return std::get<2>(valid_options[a]) < std::get<2>(valid_options[b]); });
+                int s = npus.server_idx[child.npu];
+                int latency = latency_of(s, u);
+                int duration = calculate_inference_time(child.B, servers[s].k);
+                ScheduledRequest request{u + 1, clock, s + 1, npus.id_in_server[child.npu], child.B};
+                current[u].push_back(request);
+                int handle = evaluator.insert(request);
+                evaluator.commit();
+                moves[u] += last_npu[u] >= 0 && last_npu[u] != child.npu;
+                last_npu[u] = child.npu;
+                committed_end[u] = std::max(committed_end[u], clock + latency + duration);
+                npu_free[child.npu] = std::max(npu_free[child.npu], clock + latency) + duration;
+                remaining[u] -= child.B;
+                next_send[u] = clock + latency + 1;
+                ++sent[u];
+                ++npu_jobs[child.npu];
+                refresh_term(u);
 
-                for (size_t k = 0; k < indices.size(); ++k)
-                {
-                    size_t original_idx = indices[k];
-                    // 对于少数有效选项，使用更平缓的权重分布
-                    double rank_score = static_cast<double>(indices.size() - k) + 0.5;                // +0.5避免0权重
-                    probabilities[original_idx] = std::exp(rank_score / (SOFTMAX_TEMPERATURE * 2.0)); // 温度放大
-                    sum_exp += probabilities[original_idx];
-                }
+                search(depth + 1);
+
+                --npu_jobs[child.npu];
+                --sent[u];
+                remaining[u] = saved_remaining;
+                next_send[u] = saved_send;
+                last_npu[u] = saved_last;
+                moves[u] = saved_moves;
+                committed_end[u] = saved_end;
+                npu_free[child.npu] = saved_free;
+                evaluator.remove(handle);
+                evaluator.commit();
+                current[u].pop_back();
+            }
+            term[u] = saved_term;
+            late[u] = saved_late;
+            term_sum = saved_sum;
+            late_count = saved_count;
+            if (aborted)
+                return;
+        }
+    }
+
+    const ExactParams &params;
+    std::vector<std::vector<int>> chain;
+    int min_latency = 0;
+    std::vector<int> max_b_any;
+    std::vector<int> remaining, last_npu, moves, sent, late, npu_jobs;
+    std::vector<long long> next_send, committed_end, npu_free, fixed_end;
+    std::vector<double> term;
+    double term_sum = 0;
+    int late_count = 0;
+    long long clock = 0;
+    Solution current, best_solution;
+    double best_score = 0;
+    double root_bound = 0;
+    long long node_count = 0;
+    bool aborted = false;
+    IncrementalEvaluator evaluator;
+    std::string key;
+    std::vector<std::pair<long long, int>> running;
+    std::unordered_set<std::string> visited;
+    size_t table_bytes = 0;
+};
+
+// --- rollout 前瞻 ---
+// 几个就绪用户争抢同一块快NPU时，成本函数只能按固定权重猜测。rollout 模式在决策循环中成本最低的几个候选
+// 相差不大(与第一名的相对差距不超过 gap)时把这次决策视为有争议的决策: 对每个候选，以"已做的决策 + 该候选"
+// 为前缀(run_greedy 的 pinned 前缀模式)跑 K 次随机贪心补全，按补全方案精确得分的均值选候选，均值相同时取成本低的。
+// 补全任务放在工作窃取线程池上并行执行。只有有争议的决策做 rollout，且按时间顺序最多做 decisions 次；
+// 限时运行时按最慢一次的耗时预估，来不及时其余决策退回普通采样。不限时运行时补全总数不超过 completions，
+// 每次补全不比一次完整的贪心慢，总耗时不超过约 completions+2 次贪心，结果可按种子复现。
+struct RolloutParams
+{
+    int rollouts = 8;          // 每个候选的补全次数 K
+    int candidates = 3;        // 参与比较的候选数上限
+    double gap = 0.05;         // 有争议的判定阈值(成本的相对差距)
+    int decisions = 64;        // 最多做 rollout 的决策数
+    double temperature = 1e-6; // 补全的采样温度
+    long long completions = 64; // 不限时运行时的补全总数上限
+};
+
+// 每个工作线程有自己的双端队列: 提交的任务轮流放入各队列，线程从自己队列的头部取任务，
+// 自己的队列空了就从其他线程队列的尾部窃取。工作线程启动时复制一份创建线程读入的 users / npus。
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int threads)
+    {
+        const UserTable &input_users = users;
+        const NpuTable &input_npus = npus;
+        for (int t = 0; t < threads; ++t)
+            queues.push_back(std::make_unique<Queue>());
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([this, &input_users, &input_npus, t]()
+                                 {
+                                     users = input_users;
+                                     npus = input_npus;
+                                     {
+                                         std::lock_guard<std::mutex> lock(state_mutex);
+                                         ++started;
+                                     }
+                                     state_cv.notify_all();
+                                     work(t); });
+        }
+        // 等所有线程复制完输入，之后创建线程才能继续修改自己的 users / npus
+        std::unique_lock<std::mutex> lock(state_mutex);
+        state_cv.wait(lock, [&]() { return started == threads; });
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            stopping = true;
+        }
+        state_cv.notify_all();
+        for (std::thread &th : workers)
+            th.join();
+    }
+
+    void submit(std::function<void()> task)
+    {
+        Queue &queue = *queues[next_queue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            ++queued;
+            ++pending;
+        }
+        state_cv.notify_all();
+    }
+
+    // 等待已提交的任务全部完成
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        state_cv.wait(lock, [&]() { return pending == 0; });
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(int self, std::function<void()> &task)
+    {
+        for (size_t step = 0; step < queues.size(); ++step)
+        {
+            Queue &queue = *queues[(self + step) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (step == 0)
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
             }
             else
             {
-                // 有效选项较多时，使用成本归一化 + 温度softmax
-                std::vector<long long> costs;
-                for (const auto &option : valid_options)
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void work(int self)
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            if (take(self, task))
+            {
                 {
-                    costs.push_back(std::get<2>(option));
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    --queued;
                 }
+                task();
+                bool finished;
+                {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    finished = --pending == 0;
+                }
+                if (finished)
+                    state_cv.notify_all();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(state_mutex);
+            state_cv.wait(lock, [&]() { return stopping || queued > 0; });
+            if (stopping && queued == 0)
+                return;
+        }
+    }
 
-                // 找到最小和最大成本
-                long long min_cost = *std::min_element(costs.begin(), costs.end());
-                long long max_cost = *std::max_element(costs.begin(), costs.end());
-                long long cost_range = std::max(1LL, max_cost - min_cost);
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex state_mutex;
+    std::condition_variable state_cv;
+    int started = 0;
+    size_t queued = 0;  // 还在队列中的任务数
+    size_t pending = 0; // 尚未完成的任务数
+    bool stopping = false;
+    size_t next_queue = 0;
+};
 
-                for (size_t k = 0; k < valid_options.size(); ++k)
-                {
-                    long long cost = std::get<2>(valid_options[k]);
-                    // 将cost映射到[0, 1]区间，然后转换为效用（越小的cost，效用越大）
-                    double normalized_cost = static_cast<double>(cost - min_cost) / cost_range;
-                    double utility = 1.0 - normalized_cost; // cost小的utility大
+// 第 d 次 rollout 决策中第 c 个候选的第 k 次补全，随机流键为 (seed, ROLLOUT_STREAM + d, c * K + k)
+const uint32_t ROLLOUT_STREAM = 0x40000000u;
 
-                    probabilities[k] = std::exp(utility / SOFTMAX_TEMPERATURE);
-                    sum_exp += probabilities[k];
-                }
+class RolloutPlanner
+{
+public:
+    RolloutPlanner(WorkStealingPool &pool, const RolloutParams &params, uint64_t seed, const TimeBudget &budget)
+        : pool(pool), params(params), seed(seed), budget(budget) {}
+
+    int choose(const CostInfo *costs, const int *user_indices, size_t rows, size_t cols, const Solution &solution)
+    {
+        if (decisions >= params.decisions || !budget.allows(slowest_decision))
+            return -1;
+
+        // 成本最低的候选，只保留与第一名相差不超过 gap 的
+        const long long INF = std::numeric_limits<long long>::max();
+        ranked.clear();
+        for (size_t idx = 0; idx < rows * cols; ++idx)
+        {
+            if (costs[idx].cost != INF)
+                ranked.push_back({costs[idx].cost, static_cast<int>(idx)});
+        }
+        size_t take = std::min(ranked.size(), static_cast<size_t>(params.candidates));
+        std::partial_sort(ranked.begin(), ranked.begin() + take, ranked.end());
+        if (take < 2)
+            return -1;
+        long long limit = ranked[0].first + static_cast<long long>(params.gap * std::max(std::llabs(ranked[0].first), 1LL));
+        while (take > 1 && ranked[take - 1].first > limit)
+            --take;
+        if (take < 2)
+            return -1;
+        // 不限时运行时按补全次数限制总耗时
+        if (!budget.limited && completions + static_cast<long long>(take) * params.rollouts > params.completions)
+            return -1;
+
+        Clock::time_point decision_start = Clock::now();
+        prefixes.assign(take, solution);
+        for (size_t c = 0; c < take; ++c)
+        {
+            int idx = ranked[c].second;
+            int user = user_indices[idx / cols];
+            int npu_idx = idx % static_cast<int>(cols);
+            prefixes[c][user].push_back({user + 1, users.next_send_time[user], npus.server_idx[npu_idx] + 1,
+                                         npus.id_in_server[npu_idx], costs[idx].optimal_B});
+        }
+
+        const int K = params.rollouts;
+        scores.assign(take * K, 0);
+        uint32_t stream = ROLLOUT_STREAM + static_cast<uint32_t>(decisions);
+        for (size_t c = 0; c < take; ++c)
+        {
+            for (int k = 0; k < K; ++k)
+            {
+                size_t slot = c * K + k;
+                pool.submit([this, c, slot, stream]()
+                            {
+                                Philox4x32 rng(seed, stream, static_cast<uint32_t>(slot));
+                                Solution completion;
+                                run_greedy(rng, params.temperature, completion, &prefixes[c]);
+                                // 没能排完全部样本的补全记0分
+                                for (int i = 0; i < M; ++i)
+                                {
+                                    if (users.remaining_cnt[i] > 0)
+                                        return;
+                                }
+                                IncrementalEvaluator evaluator;
+                                evaluator.build(completion);
+                                scores[slot] = evaluator.score();
+                                std::lock_guard<std::mutex> lock(best_mutex);
+                                if (scores[slot] > best_score)
+                                {
+                                    best_score = scores[slot];
+                                    best_solution = std::move(completion);
+                                } });
             }
+        }
+        pool.wait();
 
-            // 归一化为概率分布
-            for (double &prob : probabilities)
+        size_t best = 0;
+        double best_sum = -1;
+        for (size_t c = 0; c < take; ++c)
+        {
+            double sum = std::accumulate(scores.begin() + c * K, scores.begin() + (c + 1) * K, 0.0);
+            if (sum > best_sum)
             {
-                prob /= sum_exp;
+                best_sum = sum;
+                best = c;
             }
+        }
 
-            // 按概率分布随机采样
-            static std::random_device rd;
-            static std::mt19937 gen(rd());
-            std::discrete_distribution<> dist(probabilities.begin(), probabilities.end());
+        ++decisions;
+        completions += static_cast<long long>(take) * K;
+        changed += best != 0;
+        slowest_decision = std::max(slowest_decision, Clock::now() - decision_start);
+        return ranked[best].second;
+    }
 
-            int selected_idx = dist(gen);
-            best_user_idx = std::get<0>(valid_options[selected_idx]);
-            best_npu_idx = std::get<1>(valid_options[selected_idx]);
-            best_B = cost_matrix[best_user_idx][best_npu_idx].optimal_B;
-            best_finish_time = cost_matrix[best_user_idx][best_npu_idx].finish_time;
-            best_cost = cost_matrix[best_user_idx][best_npu_idx].cost;
-        }
+    int decisions = 0;        // 做了 rollout 的决策数
+    long long completions = 0; // 补全总次数
+    int changed = 0;          // rollout 没有选成本最低候选的决策数
+    double best_score = -1;   // 所有补全中得分最高的完整方案及其得分
+    Solution best_solution;
 
-        // --- 执行最优调度 ---
-        if (best_user_idx != -1)
-        {
-            int user_id = users[best_user_idx].id;
-            long long send_time = users[best_user_idx].next_send_time;
-            int server_id = npus[best_npu_idx].server_id;
-            int npu_id = npus[best_npu_idx].id_in_server;
+private:
+    WorkStealingPool &pool;
+    const RolloutParams &params;
+    uint64_t seed;
+    const TimeBudget &budget;
+    Clock::duration slowest_decision{0};
+    std::vector<std::pair<long long, int>> ranked;
+    std::vector<Solution> prefixes;
+    std::vector<double> scores;
+    std::mutex best_mutex;
+};
+
+int rollout_choose(RolloutPlanner &planner, const CostInfo *costs, const int *user_indices, size_t rows, size_t cols,
+                   const Solution &solution)
+{
+    return planner.choose(costs, user_indices, rows, cols, solution);
+}
+
+// 带 rollout 前瞻的贪心: 非争议决策与原来的贪心相同(线程0第0次的随机流与温度)，补全在 threads 个工作线程上执行。
+// 补全本身是完整方案，按补全均值选出的候选之后的走向可能比补全更差，rollout 方案也就可能不如它出发的基础贪心。
+// 因此返回基础贪心、rollout 方案与所有补全中得分最高的一个(加固的 rollout)，结果不差于基础贪心
+PassResult run_rollout_greedy(uint64_t seed, int threads, const RolloutParams &params, const TimeBudget &budget,
+                              int &decisions, long long &completions, int &changed)
+{
+    IncrementalEvaluator evaluator;
+    PassResult base;
+    Philox4x32 base_rng(seed, 0, 0);
+    base.loop_allocations = run_greedy(base_rng, SOFTMAX_TEMPERATURE, base.solution);
+    evaluator.build(base.solution);
+    base.score = evaluator.score();
+
+    WorkStealingPool pool(threads);
+    RolloutPlanner planner(pool, params, seed, budget);
+    PassResult pass;
+    Philox4x32 rng(seed, 0, 0);
+    pass.loop_allocations = run_greedy(rng, SOFTMAX_TEMPERATURE, pass.solution, nullptr, &planner);
+    evaluator.build(pass.solution);
+    pass.score = evaluator.score();
+    if (planner.best_score > pass.score)
+    {
+        pass.score = planner.best_score;
+        pass.solution = std::move(planner.best_solution);
+    }
+    if (base.score >= pass.score)
+    {
+        pass.score = base.score;
+        pass.solution = std::move(base.solution);
+    }
+    pass.index = (1LL << 40) + 1; // 得分相同时贪心结果优先
+    pass.thread = 0;
+    pass.phase = "rollout";
+    decisions = planner.decisions;
+    completions = planner.completions;
+    changed = planner.changed;
+    return pass;
+}
+
+// --- 岛屿模型 ---
+// 协调进程读入输入后 fork 出 islands 个工作进程，每个工作进程通过一对本地 socket 与协调进程相连，
+// 各自跑随机贪心(有 --pipeline / --stripe 时再做流水线规划)，再分 epochs 轮做改进(大邻域搜索和/或模拟退火，都没指定时做大邻域搜索)。
+// --beam / --exact / --rollouts / --replay 不能与岛屿模型同时使用。
+// 每轮结束时工作进程把自己的最优方案发给协调进程，协调进程回复当前全局最优方案，工作进程在全局最优更好时
+// 换成它继续搜索(迁移)。协调进程只汇总、不搜索，最后(或时限到达时由看门狗)写出全局最优方案。
+// 第 i 个岛第 e 轮的随机流种子为 seed + (i << 32) + e。只在 POSIX 系统上可用。
+struct IslandParams
+{
+    int islands = 0;           // 工作进程数
+    int epochs = 8;            // 交换最优方案的轮数
+    bool lns = false;          // 每轮做大邻域搜索
+    bool anneal = false;       // 每轮做模拟退火
+    bool pipeline = false;     // 随机贪心之后做流水线规划(--pipeline / --stripe)
+    bool stripe = false;
+    LnsParams lns_params;      // 不限时运行时为每轮的参数
+    AnnealParams anneal_params;
+};
+
+// 工作进程的各轮改进在剩余时间的这一比例内结束，留出最后一次交换与写出的时间
+const double ISLAND_BUDGET_SHARE = 0.9;
 
-            solution[best_user_idx].push_back({user_id, send_time, server_id, npu_id, best_B});
+#ifdef __unix__
+// 帧格式: [字数 n][得分][n 个 int64: 依次为每个用户的请求数及其各请求的 time, server, npu, B]
+bool write_all(int fd, const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
 
-            // 更新状态
-            users[best_user_idx].remaining_cnt -= best_B;
-            total_remaining_cnt -= best_B;
+bool read_all(int fd, void *data, size_t size)
+{
+    char *p = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
 
-            users[best_user_idx].last_server_id = server_id;
-            users[best_user_idx].last_npu_id_in_server = npu_id;
+bool send_solution(int fd, double score, const Solution &solution)
+{
+    std::vector<int64_t> words;
+    for (const auto &requests : solution)
+    {
+        words.push_back(static_cast<int64_t>(requests.size()));
+        for (const ScheduledRequest &r : requests)
+            words.insert(words.end(), {r.time, r.server_id, r.npu_id_in_server, r.B});
+    }
+    uint64_t count = words.size();
+    return write_all(fd, &count, sizeof(count)) && write_all(fd, &score, sizeof(score)) &&
+           write_all(fd, words.data(), words.size() * sizeof(int64_t));
+}
 
-            int server_idx = server_id - 1;
-            // 题目规则: 用户可在第 x+latency+1 毫秒发送下一个请求
-            users[best_user_idx].next_send_time = send_time + latencies[server_idx][best_user_idx] + 1;
+bool receive_solution(int fd, double &score, Solution &solution)
+{
+    uint64_t count = 0;
+    if (!read_all(fd, &count, sizeof(count)) || !read_all(fd, &score, sizeof(score)))
+        return false;
+    std::vector<int64_t> words(count);
+    if (!read_all(fd, words.data(), count * sizeof(int64_t)))
+        return false;
+    solution.assign(M, {});
+    size_t pos = 0;
+    for (int i = 0; i < M && pos < count; ++i)
+    {
+        int64_t requests = words[pos++];
+        for (int64_t j = 0; j < requests && pos + 4 <= count; ++j, pos += 4)
+        {
+            solution[i].push_back({i + 1, words[pos], static_cast<int>(words[pos + 1]), static_cast<int>(words[pos + 2]),
+                                   static_cast<int>(words[pos + 3])});
+        }
+    }
+    return pos == count;
+}
 
-            long long inference_time = best_finish_time - std::max(send_time + latencies[server_idx][best_user_idx], npus[best_npu_idx].free_at);
-            npus[best_npu_idx].free_at = best_finish_time;
-            npus[best_npu_idx].utilization_time += inference_time;
+// 工作进程: 不写标准输出，与协调进程的连接断开时直接结束
+void run_island_worker(int fd, int island, uint64_t seed, int threads, const IslandParams &params, const TimeBudget &budget)
+{
+    Incumbent incumbent;
+    uint64_t island_seed = seed + (static_cast<uint64_t>(island) << 32);
+    run_portfolio(island_seed, 1, 1, SOFTMAX_TEMPERATURE, budget_slice(budget, Clock::now(), 1.0 / (params.epochs + 1)), incumbent);
+    if (params.pipeline)
+    {
+        PassResult pass = run_pipeline_pass(params.stripe);
+        if (pass.score >= 0)
+            incumbent.offer(pass);
+    }
+    for (int epoch = 0; epoch < params.epochs; ++epoch)
+    {
+        uint64_t epoch_seed = island_seed + static_cast<uint64_t>(epoch);
+        TimeBudget epoch_budget = budget_slice(budget, Clock::now(), 1.0 / (params.epochs - epoch));
+        bool lns = params.lns || !params.anneal;
+        if (lns)
+        {
+            TimeBudget lns_budget = params.anneal ? budget_slice(epoch_budget, Clock::now(), 0.5) : epoch_budget;
+            run_lns(epoch_seed, threads, params.lns_params, lns_budget, incumbent);
         }
-        else
+        if (params.anneal)
+            run_annealing(epoch_seed, threads, params.anneal_params, epoch_budget, incumbent);
+
+        PassResult best = incumbent.snapshot();
+        PassResult migrant;
+        if (!send_solution(fd, best.score, best.solution) || !receive_solution(fd, migrant.score, migrant.solution))
+            return;
+        migrant.index = 1LL << 41; // 得分相同时保留本岛的方案
+        migrant.phase = "migrant";
+        incumbent.offer(migrant);
+    }
+}
+
+// 协调进程: fork 出工作进程并在它们结束前汇总各轮的最优方案。必须在创建任何线程之前调用 spawn
+class IslandCoordinator
+{
+public:
+    bool spawn(uint64_t seed, int threads, const IslandParams &params, const TimeBudget &budget)
+    {
+        pid_t coordinator = getpid();
+        for (int island = 0; island < params.islands; ++island)
         {
-            // --- 死循环处理 ---
-            // 在当前时间点，所有就绪的用户都无法找到任何一个NPU进行有效调度
-            // (通常因为min_b_required过大，所有服务器均不满足)
-            // 必须强制推进时间，否则会无限循环
-            long long next_possible_event_time = std::numeric_limits<long long>::max();
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+                return false;
+            pid_t pid = fork();
+            if (pid < 0)
+                return false;
+            if (pid == 0)
+            {
+#ifdef __linux__
+                // 看门狗 _Exit 时协调进程不会回收工作进程，让内核在协调进程退出时杀掉它们；fork 之后协调进程可能已经退出
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+                if (getppid() != coordinator)
+                    _exit(0);
+#endif
+                close(fds[0]);
+                for (int fd : sockets)
+                    close(fd);
+                run_island_worker(fds[1], island, seed, threads, params, budget);
+                close(fds[1]);
+                _exit(0);
+            }
+            close(fds[1]);
+            sockets.push_back(fds[0]);
+            children.push_back(pid);
+        }
+        return true;
+    }
 
-            // 找到下一个NPU释放的时刻
-            for (const auto &npu : npus)
+    // 每收到一个岛的方案就提交到 incumbent，并把全局最优方案发回该岛；所有岛结束后返回交换次数
+    long long collect(Incumbent &incumbent)
+    {
+        std::vector<pollfd> fds;
+        for (size_t island = 0; island < sockets.size(); ++island)
+            fds.push_back({sockets[island], POLLIN, 0});
+        std::vector<int> epoch(sockets.size(), 0);
+        Solution best_solution;
+        double best_score = -1;
+        long long exchanges = 0;
+        size_t open = fds.size();
+        while (open > 0 && poll(fds.data(), fds.size(), -1) > 0)
+        {
+            for (size_t island = 0; island < fds.size(); ++island)
             {
-                if (npu.free_at > current_time)
+                if (fds[island].fd < 0 || fds[island].revents == 0)
+                    continue;
+                PassResult pass;
+                if (!receive_solution(fds[island].fd, pass.score, pass.solution))
+                {
+                    close(fds[island].fd);
+                    fds[island].fd = -1;
+                    --open;
+                    continue;
+                }
+                if (pass.score > best_score)
                 {
-                    next_possible_event_time = std::min(next_possible_event_time, npu.free_at);
+                    best_score = pass.score;
+                    best_solution = pass.solution;
                 }
+                pass.index = (1LL << 40) + exchanges; // 得分相同时先到的优先
+                pass.thread = static_cast<int>(island);
+                pass.restart = epoch[island]++;
+                pass.phase = "island";
+                incumbent.offer(pass);
+                send_solution(fds[island].fd, best_score, best_solution);
+                ++exchanges;
             }
+        }
+        for (pid_t pid : children)
+            waitpid(pid, nullptr, 0);
+        return exchanges;
+    }
 
-            if (next_possible_event_time == std::numeric_limits<long long>::max())
+private:
+    std::vector<int> sockets;
+    std::vector<pid_t> children;
+};
+#endif
+
+int main(int argc, char *argv[])
+{
+    Clock::time_point program_start = Clock::now();
+
+    // --report: 输出方案后用精确评估器回放，在标准错误输出真实得分
+    // --seed S: 随机种子，缺省为 DEFAULT_SEED
+    // --restarts R: 随机贪心的总次数，缺省为1(只跑原来的贪心)；限时运行时缺省不限次数
+    // --threads T: 并行线程数，缺省为1，不超过 restarts
+    // --temperature X: 探索温度，缺省为1e-5
+    // --replay T R: 只重跑线程T的第R次贪心(需与原运行使用相同的 --seed / --temperature)
+    // --time-limit S: 墙钟时限(秒)，从进程启动算起，时间用完前持续改进；缺省为0即不限时
+    //   (只跑 --restarts 次，各阶段按步数运行，结果可按种子复现)
+    // --safety-margin MS: 时限前预留的毫秒数，到时无论改进是否结束都写出当前最优方案，缺省1000
+    // --anneal: 随机贪心之后对最优方案做模拟退火；限时运行时随机贪心只用前 GREEDY_BUDGET_SHARE 的时间
+    // --anneal-moves N / --anneal-t0 X / --anneal-t1 X: 不限时运行时每个线程的退火步数，以及初始/结束温度
+    // --beam W / --beam-expand C: 随机贪心之后用宽度W的束搜索构造方案，每个部分方案扩展C个候选(缺省4)
+    // --lns: 随机贪心之后(退火之前)做大邻域搜索；与 --anneal 同时使用时两者平分剩余时间
+    // --lns-users K / --lns-iterations N / --lns-temperature X: 每轮拆掉的用户数、不限时运行时每个线程的轮数、重新调度的采样温度
+    // --rollouts K: 随机贪心之后(束搜索之后)跑一次带 rollout 前瞻的贪心，有争议的决策每个候选补全K次
+    // --rollout-candidates C / --rollout-gap X / --rollout-decisions N: 参与比较的候选数(缺省3)、有争议的相对成本差距(缺省0.05)、
+    //   最多做 rollout 的决策数(缺省64)
+    // --rollout-temperature X: 补全的采样温度，缺省为1e-6
+    // --rollout-completions N: 不限时运行时补全的总次数上限，缺省64
+    // --exact / --exact-nodes N: 随机贪心之后用分支定界求极小实例(不超过 EXACT_MAX_USERS 个用户)的最优方案，
+    //   搜索节点上限缺省2e7；--report 输出证明的最优值，或搜索未完成时的当前最优与所有方案的得分上界
+    // --islands N / --island-epochs E: 岛屿模型，N个工作进程各自搜索，分E轮(缺省8)与协调进程交换最优方案；
+    //   每个岛做 --lns / --anneal 指定的改进(都没指定时做大邻域搜索)，不限时运行时 --lns-iterations / --anneal-moves 为每轮的量；
+    //   每个工作进程的线程数为 --threads，缺省为CPU核数除以N；--pipeline / --stripe 在每个岛的随机贪心之后做，
+    //   不能与 --beam / --exact / --rollouts / --replay 同时使用
+    // --colocate: 贪心之前做共置规划，为每个用户指定NPU，贪心的成本函数引导用户发往指定的NPU
+    // --pipeline: 随机贪心之前做流水线规划，每个用户按最大发送速率在单个NPU上连续发送(与 --colocate 同时使用时发往指定的NPU)
+    // --stripe: 流水线规划中单个NPU赶不上截止时刻的用户轮流发往同一服务器上按时完成所需的最少NPU(隐含 --pipeline)
+    bool report = false;
+    uint64_t seed = DEFAULT_SEED;
+    long long restarts = 0;
+    int threads = 0;
+    double exploration_temperature = 1e-5;
+    int replay_thread = -1;
+    int replay_restart = -1;
+    double time_limit = 0;
+    long long safety_margin_ms = 1000;
+    bool anneal = false;
+    AnnealParams anneal_params;
+    bool lns = false;
+    LnsParams lns_params;
+    bool beam = false;
+    BeamParams beam_params;
+    bool rollout = false;
+    RolloutParams rollout_params;
+    IslandParams island_params;
+    bool exact = false;
+    ExactParams exact_params;
+    bool colocate = false;
+    bool pipeline = false;
+    bool stripe = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--report") == 0)
+            report = true;
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--restarts") == 0 && i + 1 < argc)
+            restarts = std::max(1LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--temperature") == 0 && i + 1 < argc)
+            exploration_temperature = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 2 < argc)
+        {
+            replay_thread = std::atoi(argv[++i]);
+            replay_restart = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc)
+            time_limit = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--safety-margin") == 0 && i + 1 < argc)
+            safety_margin_ms = std::max(0LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--anneal") == 0)
+            anneal = true;
+        else if (std::strcmp(argv[i], "--anneal-moves") == 0 && i + 1 < argc)
+            anneal_params.moves = std::max(0LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--anneal-t0") == 0 && i + 1 < argc)
+            anneal_params.t0 = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--anneal-t1") == 0 && i + 1 < argc)
+            anneal_params.t1 = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--beam") == 0 && i + 1 < argc)
+        {
+            beam = true;
+            beam_params.width = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--beam-expand") == 0 && i + 1 < argc)
+            beam_params.expand = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--lns") == 0)
+            lns = true;
+        else if (std::strcmp(argv[i], "--lns-users") == 0 && i + 1 < argc)
+            lns_params.users = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--lns-iterations") == 0 && i + 1 < argc)
+            lns_params.iterations = std::max(0LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--lns-temperature") == 0 && i + 1 < argc)
+            lns_params.temperature = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--exact") == 0)
+            exact = true;
+        else if (std::strcmp(argv[i], "--exact-nodes") == 0 && i + 1 < argc)
+            exact_params.node_limit = std::max(1LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--islands") == 0 && i + 1 < argc)
+            island_params.islands = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--island-epochs") == 0 && i + 1 < argc)
+            island_params.epochs = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--rollouts") == 0 && i + 1 < argc)
+        {
+            rollout = true;
+            rollout_params.rollouts = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--rollout-candidates") == 0 && i + 1 < argc)
+            rollout_params.candidates = std::max(2, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--rollout-gap") == 0 && i + 1 < argc)
+            rollout_params.gap = std::max(0.0, std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--rollout-decisions") == 0 && i + 1 < argc)
+            rollout_params.decisions = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--rollout-temperature") == 0 && i + 1 < argc)
+            rollout_params.temperature = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--rollout-completions") == 0 && i + 1 < argc)
+            rollout_params.completions = std::max(0LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--colocate") == 0)
+            colocate = true;
+        else if (std::strcmp(argv[i], "--pipeline") == 0)
+            pipeline = true;
+        else if (std::strcmp(argv[i], "--stripe") == 0)
+            pipeline = stripe = true;
+    }
+
+    TimeBudget budget;
+    if (time_limit > 0)
+    {
+        budget.limited = true;
+        budget.flush_at = program_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(time_limit)) -
+                          std::chrono::milliseconds(safety_margin_ms);
+    }
+    if (restarts == 0)
+    {
+        restarts = budget.limited ? std::numeric_limits<long long>::max() : 1;
+    }
+    bool explicit_threads = threads > 0;
+    if (threads == 0)
+    {
+        // 岛屿模型的工作进程缺省平分CPU核数，其余情况缺省单线程
+        threads = island_params.islands > 0 ? static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) : 1;
+    }
+    int greedy_threads = static_cast<int>(std::min<long long>(threads, restarts));
+
+    // 有改进阶段时随机贪心只占用前一部分时间
+    TimeBudget greedy_budget = anneal || lns || rollout || beam || exact ? budget_slice(budget, program_start, GREEDY_BUDGET_SHARE) : budget;
+
+    read_input();
+    if (colocate)
+    {
+        home_npu = plan_colocation();
+    }
+
+#ifdef __unix__
+    // 工作进程必须在看门狗等线程创建之前 fork
+    IslandCoordinator coordinator;
+    if (island_params.islands > 0 && (beam || exact || rollout || replay_thread >= 0))
+    {
+        // 这些阶段只在单进程模式下运行，工作进程不做
+        std::cerr << "--islands cannot be combined with --beam, --exact, --rollouts or --replay\n";
+        return 1;
+    }
+    if (island_params.islands > 0)
+    {
+        island_params.lns = lns;
+        island_params.anneal = anneal;
+        island_params.pipeline = pipeline;
+        island_params.stripe = stripe;
+        island_params.lns_params = lns_params;
+        island_params.anneal_params = anneal_params;
+        int worker_threads = explicit_threads ? threads : std::max(1, threads / island_params.islands);
+        if (!coordinator.spawn(seed, worker_threads, island_params, budget_slice(budget, Clock::now(), ISLAND_BUDGET_SHARE)))
+        {
+            std::cerr << "failed to start island workers\n";
+            return 1;
+        }
+    }
+#else
+    if (island_params.islands > 0)
+    {
+        std::cerr << "--islands requires a POSIX system, ignored\n";
+        island_params.islands = 0;
+    }
+#endif
+
+    Incumbent incumbent;
+    long long island_exchanges = 0;
+    bool exact_ran = false, exact_proven = false;
+    long long exact_nodes = 0;
+    double exact_bound = 0;
+    long long anneal_moves = 0;
+    long long lns_accepted = 0;
+    int rollout_decisions = 0, rollout_changed = 0;
+    double rollout_score = 0;
+    long long rollout_completions = 0;
+    double pipeline_score = 0;
+    {
+        Watchdog watchdog(budget, incumbent);
+        if (island_params.islands > 0)
+        {
+#ifdef __unix__
+            island_exchanges = coordinator.collect(incumbent);
+#endif
+        }
+        else
+        {
+            // 流水线规划是一次确定性的构造，放在随机贪心之前做，限时运行时不会被贪心用完的时间挤掉
+            if (pipeline)
             {
-                // 如果所有NPU都已空闲，但依然无法调度，说明存在根本性的逻辑冲突，无法解决
-                break;
+                PassResult pass = run_pipeline_pass(stripe);
+                pipeline_score = pass.score;
+                if (pass.score >= 0)
+                    incumbent.offer(pass);
             }
-
-            // 将一个被卡住的用户的时间推进到下一可能时刻，以打破僵局
-            bool advanced = false;
-            for (int i = 0; i < M; ++i)
+            if (replay_thread >= 0)
+            {
+                PassResult pass;
+                Philox4x32 rng(seed, static_cast<uint32_t>(replay_thread), static_cast<uint32_t>(replay_restart));
+                pass.loop_allocations = run_greedy(rng, pass_temperature(replay_thread, replay_restart, exploration_temperature), pass.solution);
+                pass.index = 0;
+                pass.thread = replay_thread;
+                pass.restart = replay_restart;
+                incumbent.offer(pass);
+            }
+            else
+            {
+                run_portfolio(seed, restarts, greedy_threads, exploration_temperature, greedy_budget, incumbent);
+            }
+            if (exact && M > EXACT_MAX_USERS)
             {
-                if (users[i].remaining_cnt > 0 && users[i].next_send_time <= current_time)
+                std::cerr << "--exact supports at most " << EXACT_MAX_USERS << " users, skipped\n";
+            }
+            else if (exact)
+            {
+                ExactSolver solver(exact_params);
+                PassResult pass = incumbent.snapshot();
+                exact_proven = solver.run(incumbent.snapshot(), pass.solution, pass.score);
+                exact_ran = true;
+                exact_nodes = solver.nodes();
+                exact_bound = solver.bound();
+                if (pass.score > incumbent.score())
                 {
-                    users[i].next_send_time = next_possible_event_time;
-                    advanced = true;
-                    break;
+                    pass.index = 1LL << 40;
+                    pass.thread = 0;
+                    pass.restart = -1;
+                    pass.phase = "exact";
+                    incumbent.offer(pass);
                 }
             }
-            if (!advanced)
+            if (beam)
             {
-                // 如果没有找到任何一个卡住的用户（理论上不应该），则直接退出
-                break;
+                PassResult pass;
+                BeamSearch search(beam_params);
+                if (search.run(budget, pass.solution, pass.score))
+                {
+                    pass.index = 1LL << 40; // 得分相同时贪心结果优先
+                    pass.thread = 0;
+                    pass.phase = "beam";
+                    incumbent.offer(pass);
+                }
+            }
+            if (rollout)
+            {
+                TimeBudget rollout_budget = anneal || lns ? budget_slice(budget, Clock::now(), 0.5) : budget;
+                PassResult pass = run_rollout_greedy(seed, threads, rollout_params, rollout_budget,
+                                                     rollout_decisions, rollout_completions, rollout_changed);
+                rollout_score = pass.score;
+                incumbent.offer(pass);
+            }
+            if (lns)
+            {
+                TimeBudget lns_budget = anneal ? budget_slice(budget, Clock::now(), 0.5) : budget;
+                lns_accepted = run_lns(seed, threads, lns_params, lns_budget, incumbent);
+            }
+            if (anneal)
+            {
+                anneal_moves = run_annealing(seed, threads, anneal_params, budget, incumbent);
             }
         }
+
+        // --- 输出 ---
+        incumbent.flush();
     }
 
-    // --- 输出 ---
-    for (int i = 0; i < M; ++i)
+    if (report)
     {
-        std::cout << solution[i].size() << "\n";
-        for (size_t j = 0; j < solution[i].size(); ++j)
+        const PassResult &best = incumbent.result();
+        IncrementalEvaluator evaluator;
+        evaluator.build(best.solution);
+        std::cerr << "exact score: " << evaluator.score() << ", late users: " << evaluator.late_users() << "\n";
+        std::cerr << "best pass: " << best.phase << ", seed " << seed << ", thread " << best.thread << ", restart " << best.restart << "\n";
+        if (exact_ran)
         {
-            std::cout << solution[i][j].time << " "
-                      << solution[i][j].server_id << " "
-                      << solution[i][j].npu_id_in_server << " "
-                      << solution[i][j].B;
-            if (j < solution[i].size() - 1)
-            {
-                std::cout << " ";
-            }
+            std::streamsize precision = std::cerr.precision(10); // 供 scripts/gap.py 解析
+            if (exact_proven)
+                std::cerr << "exact optimum: " << evaluator.score() << " (proven, " << exact_nodes << " nodes)\n";
+            else
+                std::cerr << "exact best: " << evaluator.score() << ", bound: " << exact_bound << " (search limit reached)\n";
+            std::cerr.precision(precision);
         }
-        std::cout << "\n";
+        if (island_params.islands > 0)
+        {
+            std::cerr << "islands: " << island_params.islands << ", exchanges: " << island_exchanges << "\n";
+        }
+        if (pipeline)
+        {
+            std::cerr << "pipeline score: " << pipeline_score << "\n";
+        }
+        if (rollout)
+        {
+            std::cerr << "rollout score: " << rollout_score << ", decisions: " << rollout_decisions << " (changed " << rollout_changed
+                      << "), completions: " << rollout_completions << "\n";
+        }
+        if (lns)
+        {
+            std::cerr << "lns rounds accepted: " << lns_accepted << "\n";
+        }
+        if (anneal)
+        {
+            std::cerr << "anneal moves evaluated: " << anneal_moves << "\n";
+        }
+        std::cerr << "elapsed: " << std::chrono::duration<double>(Clock::now() - program_start).count() << " s\n";
+#ifdef ALLOC_STATS
+        std::cerr << "heap allocations in decision loop: " << best.loop_allocations << "\n";
+#endif
     }
 
-    std::cout.flush(); // 强制清空输出缓存
-
     return 0;
-}
\ No newline at end of file
+}
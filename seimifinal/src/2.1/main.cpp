@@ -6,7 +6,6 @@
 #include <algorithm>
 #include <limits>
 #include <queue>
-#include <unordered_map>
 
 // --- 数据结构 ---
 
@@ -16,7 +15,7 @@ struct Server
     int g;                                            // NPU数量
     int k;                                            // 推理速度系数
     int m;                                            // 显存大小
-    std::unordered_map<int, double> batch_efficiency; // 缓存不同batch size的效率
+    int best_b_upto[1001];                            // best_b_upto[x]: [1, x] 内效率最高的batch size
     int max_b[501]; // 预计算每个服务器的最大batch size
 };
 
@@ -32,12 +31,103 @@ struct User
     double urgency;            // 紧急程度 = remaining_cnt / (e - current_time)
 };
 
+// NPU显存占用时间线
+// 题面的NPU会让队列中所有放得下显存的请求同时推理，不必等上一个请求推理完。按时间记录NPU已占用的显存，
+// 请求在到达后第一个使 [t, t+推理耗时) 内都放得下显存的时刻 t 开始。
+// 动态开点线段树，覆盖 [0, TIME_SPAN)，区间加、区间最大值，add 不下推(标记永久化)
+class MemoryTimeline
+{
+public:
+    static const int TIME_SPAN = 1 << 21; // 覆盖发送时刻上限1e6及之后的排队与推理
+
+    // 到达时刻 arrival 之后，第一个使 [t, t+duration) 内已占用显存加 memory 不超过 capacity 的时刻 t
+    long long earliest_start(long long arrival, int duration, int memory, int capacity) const
+    {
+        long long t = arrival;
+        while (t + duration <= TIME_SPAN)
+        {
+            int blocked = last_above(root, 0, TIME_SPAN, (int)t, (int)(t + duration), capacity - memory, 0);
+            if (blocked < 0)
+                break;
+            t = blocked + 1;
+        }
+        return t;
+    }
+
+    // 在 [start, finish) 内占用 memory
+    void occupy(long long start, long long finish, int memory)
+    {
+        finish = std::min<long long>(finish, TIME_SPAN);
+        if (start < finish)
+            root = add(root, 0, TIME_SPAN, (int)start, (int)finish, memory);
+    }
+
+private:
+    struct Node
+    {
+        int max; // 子树内的最大占用(含本节点的 add)
+        int add; // 整个区间共同的占用
+        int left, right;
+    };
+
+    int max_of(int node) const { return node < 0 ? 0 : nodes[node].max; }
+
+    int add(int node, int lo, int hi, int l, int r, int value)
+    {
+        if (node < 0)
+        {
+            node = (int)nodes.size();
+            nodes.push_back({0, 0, -1, -1});
+        }
+        if (l <= lo && hi <= r)
+        {
+            nodes[node].add += value;
+            nodes[node].max += value;
+            return node;
+        }
+        int mid = lo + (hi - lo) / 2;
+        if (l < mid)
+        {
+            int child = add(nodes[node].left, lo, mid, l, r, value);
+            nodes[node].left = child;
+        }
+        if (r > mid)
+        {
+            int child = add(nodes[node].right, mid, hi, l, r, value);
+            nodes[node].right = child;
+        }
+        nodes[node].max = nodes[node].add + std::max(max_of(nodes[node].left), max_of(nodes[node].right));
+        return node;
+    }
+
+    // [l, r) 与 [lo, hi) 的交集中占用超过 limit 的最右时刻，没有时返回-1；carry 为祖先的 add 之和
+    int last_above(int node, int lo, int hi, int l, int r, int limit, int carry) const
+    {
+        if (r <= lo || hi <= l)
+            return -1;
+        if (node < 0)
+            return carry > limit ? std::min(r, hi) - 1 : -1;
+        if (carry + nodes[node].max <= limit)
+            return -1;
+        if (hi - lo == 1)
+            return lo;
+        carry += nodes[node].add;
+        int mid = lo + (hi - lo) / 2;
+        int found = last_above(nodes[node].right, mid, hi, l, r, limit, carry);
+        return found >= 0 ? found : last_above(nodes[node].left, lo, mid, l, r, limit, carry);
+    }
+
+    int root = -1;
+    std::vector<Node> nodes;
+};
+
 struct Npu
 {
-    int server_id;     // 服务器id
-    int id_in_server;  // NPU id
-    long long free_at; // 空闲时间，在哪个时间点之后处于空闲，可以接收请求
-    int utilization;   // 使用率统计，用于负载均衡
+    int server_id;           // 服务器id
+    int id_in_server;        // NPU id
+    int utilization;         // 使用率统计，用于负载均衡
+    long long busy_until;    // 最后一个已调度请求的完成时刻，成本相同时优先选更早空闲的NPU
+    MemoryTimeline timeline; // 显存占用时间线，代替原来独占模型的空闲时间 free_at
 };
 
 struct ScheduledRequest
@@ -77,12 +167,9 @@ int calculate_optimal_batch(const Server &server, int max_samples,int user_id)
     if (max_b <= 1)
         return max_b;
 
-    // 使用 find 方法来访问 const unordered_map
-    auto it = server.batch_efficiency.find(max_b);
-    if (it != server.batch_efficiency.end()) {
-        return static_cast<int>(it->second);
-    }
-    return max_b; // 如果没有找到，返回原值
+    if (max_b > 1000)
+        return max_b;
+    return server.best_b_upto[max_b];
 }
 
 void read_input() // 读取、解析输入
@@ -142,28 +229,24 @@ void read_input() // 读取、解析输入
     {
         for (int j = 0; j < servers[i].g; ++j)
         {
-            npus.push_back({servers[i].id, j + 1, 0, 0});
+            npus.push_back({servers[i].id, j + 1, 0, 0, MemoryTimeline()});
         }
     }
 
-    // 预计算每个服务器的最佳批处理大小
+    // 预计算每个服务器的最佳批处理大小：[1, x] 的最优解由 [1, x-1] 的最优解与 x 比较得到，一次扫描即可
     for (int i = 0; i < N; ++i)
     {
+        double best_efficiency = 0;
+        int best_b = 1;
         for (int max_samples = 1; max_samples <= 1000; max_samples++)
         {
-            double best_efficiency = 0;
-            int best_b = 1;
-
-            for (int b = 1; b <= max_samples && b <= 1000; b++)
+            double efficiency = calculate_efficiency(max_samples, servers[i].k);
+            if (efficiency > best_efficiency)
             {
-                double efficiency = calculate_efficiency(b, servers[i].k);
-                if (efficiency > best_efficiency)
-                {
-                    best_efficiency = efficiency;
-                    best_b = b;
-                }
+                best_efficiency = efficiency;
+                best_b = max_samples;
             }
-            servers[i].batch_efficiency[max_samples] = best_b;  // 缓存最佳批处理大小
+            servers[i].best_b_upto[max_samples] = best_b; // 缓存最佳批处理大小
         }
     }
 }
@@ -245,7 +328,7 @@ int main() // 主函数
             std::vector<size_t> npu_indices(npus.size());
             std::iota(npu_indices.begin(), npu_indices.end(), 0);
             std::sort(npu_indices.begin(), npu_indices.end(), [](size_t a, size_t b)
-                      { return npus[a].free_at < npus[b].free_at; });
+                      { return npus[a].busy_until < npus[b].busy_until; });
 
             for (size_t npu_idx : npu_indices)
             {
@@ -257,8 +340,9 @@ int main() // 主函数
 
                 // 评估该调度的成本
                 long long arrival_time = send_time + latencies[server_idx][idx];
-                long long start_time = std::max(arrival_time, npus[npu_idx].free_at);
                 long long inference_time = static_cast<long long>(std::ceil((double)optimal_B / (servers[server_idx].k * std::sqrt(optimal_B))));
+                long long start_time = npus[npu_idx].timeline.earliest_start(arrival_time, (int)inference_time,
+                                                                             a[idx + 1] * optimal_B + b[idx + 1], servers[server_idx].m);
                 long long finish_time = start_time + inference_time;
 
                 // 成本函数：完成时间 + 紧急度权重 + 迁移惩罚
@@ -321,7 +405,10 @@ int main() // 主函数
             int server_idx = server_id - 1;
             users[best_user_idx].next_send_time = send_time + latencies[server_idx][best_user_idx] + 1;
 
-            npus[best_npu_idx].free_at = best_finish_time;
+            long long inference_time = static_cast<long long>(std::ceil((double)best_B / (servers[server_idx].k * std::sqrt(best_B))));
+            npus[best_npu_idx].timeline.occupy(best_finish_time - inference_time, best_finish_time,
+                                               a[best_user_idx + 1] * best_B + b[best_user_idx + 1]);
+            npus[best_npu_idx].busy_until = std::max(npus[best_npu_idx].busy_until, best_finish_time);
             npus[best_npu_idx].utilization++; // 增加使用计数
         }
         else
@@ -6,9 +6,19 @@
 #include <map>
 #include <set>
 #include <climits>
+#include <cstdint>
+#include <numeric>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 
+const int MAX_REQUESTS = 300;
+const int BATCH_HINT_MAX = 255; // 批次提示取最大值时不缩小批次，与原规划一致
+
 struct Server {
     int npus;
     int speed_coef;
@@ -31,15 +41,107 @@ struct Task {
     int batch;
 };
 
+// NPU显存占用时间线
+// 题面的NPU会让队列中所有放得下显存的请求同时推理。按时间记录NPU已占用的显存，请求在到达后
+// 第一个使 [t, t+推理耗时) 内都放得下显存的时刻 t 开始，规划时用它代替只记最后完成时刻的独占模型。
+// 用户逐个规划，请求的时刻不是单调的，所以用动态开点线段树(区间加、区间最大值，add 不下推)覆盖 [0, TIME_SPAN)
+class MemoryTimeline {
+public:
+    static const int TIME_SPAN = 1 << 21; // 覆盖发送时刻上限1e6及之后的排队与推理
+
+    void clear() {
+        root = -1;
+        nodes.clear();
+    }
+
+    // 到达时刻 arrival 之后，第一个使 [t, t+duration) 内已占用显存加 memory 不超过 capacity 的时刻 t
+    int earliest_start(int arrival, int duration, int memory, int capacity) const {
+        int t = arrival;
+        while (t + duration <= TIME_SPAN) {
+            int blocked = last_above(root, 0, TIME_SPAN, t, t + duration, capacity - memory, 0);
+            if (blocked < 0) break;
+            t = blocked + 1;
+        }
+        return t;
+    }
+
+    // [l, r) 内已占用显存的最大值
+    int max_occupancy(int l, int r) const {
+        r = min(r, TIME_SPAN);
+        return l < r ? query_max(root, 0, TIME_SPAN, l, r) : 0;
+    }
+
+    // 在 [start, finish) 内占用 memory
+    void occupy(int start, int finish, int memory) {
+        finish = min(finish, TIME_SPAN);
+        if (start < finish) root = add(root, 0, TIME_SPAN, start, finish, memory);
+    }
+
+private:
+    struct Node {
+        int max; // 子树内的最大占用(含本节点的 add)
+        int add; // 整个区间共同的占用
+        int left, right;
+    };
+
+    int max_of(int node) const { return node < 0 ? 0 : nodes[node].max; }
+
+    int add(int node, int lo, int hi, int l, int r, int value) {
+        if (node < 0) {
+            node = nodes.size();
+            nodes.push_back({0, 0, -1, -1});
+        }
+        if (l <= lo && hi <= r) {
+            nodes[node].add += value;
+            nodes[node].max += value;
+            return node;
+        }
+        int mid = lo + (hi - lo) / 2;
+        if (l < mid) {
+            int child = add(nodes[node].left, lo, mid, l, r, value);
+            nodes[node].left = child;
+        }
+        if (r > mid) {
+            int child = add(nodes[node].right, mid, hi, l, r, value);
+            nodes[node].right = child;
+        }
+        nodes[node].max = nodes[node].add + max(max_of(nodes[node].left), max_of(nodes[node].right));
+        return node;
+    }
+
+    int query_max(int node, int lo, int hi, int l, int r) const {
+        if (node < 0 || r <= lo || hi <= l) return 0;
+        if (l <= lo && hi <= r) return nodes[node].max;
+        int mid = lo + (hi - lo) / 2;
+        return nodes[node].add + max(query_max(nodes[node].left, lo, mid, l, r), query_max(nodes[node].right, mid, hi, l, r));
+    }
+
+    // [l, r) 与 [lo, hi) 的交集中占用超过 limit 的最右时刻，没有时返回-1；carry 为祖先的 add 之和
+    int last_above(int node, int lo, int hi, int l, int r, int limit, int carry) const {
+        if (r <= lo || hi <= l) return -1;
+        if (node < 0) return carry > limit ? min(r, hi) - 1 : -1;
+        if (carry + nodes[node].max <= limit) return -1;
+        if (hi - lo == 1) return lo;
+        carry += nodes[node].add;
+        int mid = lo + (hi - lo) / 2;
+        int found = last_above(nodes[node].right, mid, hi, l, r, limit, carry);
+        return found >= 0 ? found : last_above(nodes[node].left, lo, mid, l, r, limit, carry);
+    }
+
+    int root = -1;
+    vector<Node> nodes;
+};
+
 struct NPULoad {
     int total_load = 0;
-    int last_available_time = 0;
+    MemoryTimeline timeline; // 显存占用时间线
 };
 
 vector<Server> servers;
 vector<User> users;
 vector<vector<int>> latency;
-vector<vector<NPULoad>> npu_loads;
+bool packed_batch = false; // --packed-batch: 到达时放不下原批次时按NPU吞吐改选批次
+thread_local vector<vector<NPULoad>> npu_loads; // 规划过程中的NPU负载，GA并行解码时每个线程各一份
 
 int calculate_inference_time(int batch_size, int speed_coef) {
     return (int)ceil((double)batch_size / (speed_coef * sqrt(batch_size)));
@@ -70,37 +172,69 @@ double calculate_fitness(int user_id, int server_id, int npu_id) {
     return speed_factor * latency_factor * memory_factor * load_factor * priority_factor;
 }
 
-// 智能批次大小选择
-int select_optimal_batch_size(int user_id, int server_id, int remaining_samples) {
+// 并发感知的批次选择
+// NPU同时推理所有放得下显存的请求。到达时NPU上驻留的请求留下的空闲显存 F 放得下原策略的批次时沿用原策略
+// (样本多时用最大批次，略多于最大批次时分两半，否则一次发完)；放不下时原批次只能排队，
+// 改为在 F 内按 floor(F/(a*B+b)) * B / 推理耗时 (NPU每毫秒推理的样本数) 最大选批次，并列时取较大的B，
+// 批次下限为在剩余请求数内发完所需的批次；F 放不下任何批次时仍用原批次排队。
+// 只在 --packed-batch 时改选，缺省总用原策略的批次。
+// batch_hint < BATCH_HINT_MAX 时把可用的最大批次缩到 max_batch * (batch_hint+1) / 256，
+// 但不小于在剩余请求数内发完全部样本所需的批次
+int select_optimal_batch_size(int user_id, int server_id, int npu_id, int current_time, int remaining_samples,
+                              int batch_hint = BATCH_HINT_MAX, int sent_requests = 0) {
     int max_batch = get_max_batch_size(user_id, server_id);
     if (max_batch <= 0) return 0;
-    
-    // 考虑多个因素选择批次大小
-    int conservative_batch = min(max_batch, remaining_samples);
-    
-    // 如果剩余样本很少，直接处理
-    if (remaining_samples <= max_batch) {
-        return remaining_samples;
+    const User& user = users[user_id];
+    const Server& server = servers[server_id];
+    int requests_left = max(1, MAX_REQUESTS - sent_requests);
+    int required = (remaining_samples + requests_left - 1) / requests_left;
+    if (batch_hint < BATCH_HINT_MAX) {
+        max_batch = max(min(required, max_batch), max(1, max_batch * (batch_hint + 1) / 256));
     }
     
-    // 使用动态批次大小策略
-    int optimal_batch;
-    if (remaining_samples > max_batch * 3) {
-        // 大量样本：使用较大批次
-        optimal_batch = max_batch;
-    } else if (remaining_samples > max_batch) {
-        // 中等样本：平衡批次大小
-        optimal_batch = min(max_batch, remaining_samples / 2);
+    int batch;
+    if (remaining_samples <= max_batch) {
+        batch = remaining_samples; // 剩余样本很少，直接处理
+    } else if (remaining_samples > max_batch * 3) {
+        batch = max_batch; // 大量样本：使用较大批次
     } else {
-        // 少量样本：一次处理
-        optimal_batch = remaining_samples;
+        batch = max(1, min(max_batch, remaining_samples / 2)); // 中等样本：平衡批次大小
     }
     
-    return max(1, min(optimal_batch, max_batch));
+    if (!packed_batch) return batch;
+    
+    int arrival_time = current_time + latency[server_id][user_id];
+    int free_memory = server.memory - npu_loads[server_id][npu_id].timeline.max_occupancy(
+        arrival_time, arrival_time + calculate_inference_time(batch, server.speed_coef));
+    if (user.memory_a * batch + user.memory_b <= free_memory) return batch;
+    
+    // 同时放得下的请求数和推理耗时都不变的区间内，每毫秒样本数随B增大，只比较两者各自阶梯的右端点
+    int lo = max(1, required), hi = batch - 1;
+    int best = batch;
+    long long best_num = 0, best_den = 1;
+    auto consider = [&](int B) {
+        if (B < lo || B > hi) return;
+        long long copies = free_memory / (user.memory_a * B + user.memory_b);
+        if (copies <= 0) return;
+        long long num = copies * B, den = calculate_inference_time(B, server.speed_coef);
+        if (num * best_den > best_num * den || (num * best_den == best_num * den && B > best)) {
+            best = B;
+            best_num = num;
+            best_den = den;
+        }
+    };
+    consider(hi);
+    int k = server.speed_coef;
+    for (int t = 1; (t * k) * (t * k) < hi; t++) consider((t * k) * (t * k));
+    if (user.memory_a > 0) {
+        for (int n = 1; n * user.memory_b < free_memory; n++) consider((free_memory / n - user.memory_b) / user.memory_a);
+    }
+    return best;
 }
 
 // 为用户生成优化的调度方案
-vector<Task> generate_optimized_schedule(int user_id) {
+// batch_hint 见 select_optimal_batch_size。只用插入保留适合度最高的5个候选，结果与完整排序后取前5个相同
+vector<Task> generate_optimized_schedule(int user_id, int batch_hint = BATCH_HINT_MAX) {
     vector<Task> schedule;
     const User& user = users[user_id];
     
@@ -108,41 +242,60 @@ vector<Task> generate_optimized_schedule(int user_id) {
     int current_time = user.start_time;
     int last_server = -1, last_npu = -1;
     
+    static thread_local vector<double> server_factor;
+    // 适合度中只与服务器有关的部分，按 calculate_fitness 的相乘顺序预先算好
+    server_factor.resize(servers.size());
+    for (int s = 0, S = servers.size(); s < S; s++) {
+        double speed_factor = servers[s].speed_coef;
+        double latency_factor = 1000.0 / (latency[s][user_id] + 1);
+        double memory_factor = get_max_batch_size(user_id, s) / 1000.0;
+        server_factor[s] = speed_factor * latency_factor * memory_factor;
+    }
+    
     while (remaining_samples > 0 && current_time < user.end_time) {
-        vector<tuple<double, int, int>> candidates;
+        tuple<double, int, int> candidates[5];
+        int top = 0;
         
         // 评估所有服务器-NPU组合
         for (int s = 0; s < servers.size(); s++) {
             for (int n = 0; n < servers[s].npus; n++) {
-                double fitness = calculate_fitness(user_id, s, n);
+                double load_factor = 1000.0 / (npu_loads[s][n].total_load + 1);
+                double fitness = server_factor[s] * load_factor * user.priority;
                 
                 // 给继续使用同一NPU的选择额外加分（减少迁移）
                 if (s == last_server && n == last_npu) {
                     fitness *= 1.2;
                 }
                 
-                candidates.push_back({fitness, s, n});
+                tuple<double, int, int> candidate{fitness, s, n};
+                if (top < 5 || candidate > candidates[top - 1]) {
+                    int k = min(top, 4);
+                    for (; k > 0 && candidates[k - 1] < candidate; k--) candidates[k] = candidates[k - 1];
+                    candidates[k] = candidate;
+                    top = min(top + 1, 5);
+                }
             }
         }
         
-        // 按适合度排序
-        sort(candidates.rbegin(), candidates.rend());
-        
         bool scheduled = false;
         
         // 尝试前几个最优选择
-        for (int i = 0; i < min(5, (int)candidates.size()) && !scheduled; i++) {
+        for (int i = 0; i < top && !scheduled; i++) {
             int server_id = get<1>(candidates[i]);
             int npu_id = get<2>(candidates[i]);
             
-            int batch_size = select_optimal_batch_size(user_id, server_id, remaining_samples);
+            int batch_size = select_optimal_batch_size(user_id, server_id, npu_id, current_time, remaining_samples,
+                                                       batch_hint, (int)schedule.size());
             
             if (batch_size > 0) {
                 int arrival_time = current_time + latency[server_id][user_id];
                 int inference_time = calculate_inference_time(batch_size, servers[server_id].speed_coef);
+                int memory = user.memory_a * batch_size + user.memory_b;
+                int start_time = npu_loads[server_id][npu_id].timeline.earliest_start(
+                    arrival_time, inference_time, memory, servers[server_id].memory);
                 
                 // 检查时间约束
-                if (arrival_time + inference_time <= user.end_time + 5000) { // 给一些缓冲
+                if (start_time + inference_time <= user.end_time + 5000) { // 给一些缓冲
                     Task task;
                     task.time = current_time;
                     task.server = server_id + 1;
@@ -153,7 +306,7 @@ vector<Task> generate_optimized_schedule(int user_id) {
                     
                     // 更新状态
                     npu_loads[server_id][npu_id].total_load += batch_size;
-                    npu_loads[server_id][npu_id].last_available_time = arrival_time + inference_time;
+                    npu_loads[server_id][npu_id].timeline.occupy(start_time, start_time + inference_time, memory);
                     
                     remaining_samples -= batch_size;
                     current_time += latency[server_id][user_id] + 1;
@@ -174,10 +327,299 @@ vector<Task> generate_optimized_schedule(int user_id) {
     return schedule;
 }
 
-int main() {
+// ---------------- 精确评估 ----------------
+// 按题面的NPU队列规则回放方案(与 sim/ 的模拟器相同): 每个NPU独立回放，在到达/完成事件之间跳跃，
+// 每个时刻移除完成的请求、加入到达的请求，按(到达时刻, 用户编号)从队首扫描，放得下显存的请求开始推理。
+
+// 推理耗时 ceil(sqrt(B)/k) 的整数精确计算
+int exact_inference_time(int batch_size, int speed_coef) {
+    int t = (int)sqrt((double)batch_size) / speed_coef;
+    while ((t * speed_coef) * (t * speed_coef) < batch_size) t++;
+    while (t > 1 && ((t - 1) * speed_coef) * ((t - 1) * speed_coef) >= batch_size) t--;
+    return t;
+}
+
+struct Job {
+    long long arrival;
+    int user;
+    int mem;
+    int duration;
+};
+
+// 方案不合法(样本没发完、请求数超出上限)时返回负数: 缺的样本数与多出的请求数之和的相反数
+double evaluate_schedule(const vector<vector<Task>>& schedules) {
+    int M = users.size();
+    long long violations = 0;
+    for (int i = 0; i < M; i++) {
+        long long sent = 0;
+        for (const Task& task : schedules[i]) sent += task.batch;
+        violations += users[i].sample_count - sent;
+        violations += max(0, (int)schedules[i].size() - MAX_REQUESTS);
+    }
+    if (violations > 0) return -(double)violations;
+    
+    // 按NPU分组，jobs[offset[s] + n] 是服务器s第n个NPU上的请求
+    static thread_local vector<vector<Job>> jobs;
+    vector<int> offset(servers.size() + 1, 0);
+    for (int s = 0, S = servers.size(); s < S; s++) offset[s + 1] = offset[s] + servers[s].npus;
+    jobs.resize(offset.back());
+    for (vector<Job>& queue : jobs) queue.clear();
+    for (int i = 0; i < M; i++) {
+        for (const Task& task : schedules[i]) {
+            int s = task.server - 1;
+            jobs[offset[s] + task.npu - 1].push_back({(long long)task.time + latency[s][i], i,
+                                                      users[i].memory_a * task.batch + users[i].memory_b,
+                                                      exact_inference_time(task.batch, servers[s].speed_coef)});
+        }
+    }
+    
+    vector<long long> end(M, 0);
+    for (int s = 0, S = servers.size(); s < S; s++) {
+        for (int n = 0; n < servers[s].npus; n++) {
+            vector<Job>& queue = jobs[offset[s] + n];
+            sort(queue.begin(), queue.end(), [](const Job& x, const Job& y) {
+                return x.arrival != y.arrival ? x.arrival < y.arrival : x.user < y.user;
+            });
+            
+            priority_queue<pair<long long, int>, vector<pair<long long, int>>, greater<pair<long long, int>>> running;
+            vector<int> waiting;
+            size_t next_arrival = 0;
+            int used = 0;
+            while (next_arrival < queue.size() || !waiting.empty()) {
+                long long t = next_arrival < queue.size() ? queue[next_arrival].arrival : LLONG_MAX;
+                if (!running.empty()) t = min(t, running.top().first);
+                while (!running.empty() && running.top().first <= t) {
+                    used -= running.top().second;
+                    running.pop();
+                }
+                while (next_arrival < queue.size() && queue[next_arrival].arrival <= t) {
+                    waiting.push_back(next_arrival++);
+                }
+                size_t kept = 0;
+                for (int w : waiting) {
+                    const Job& job = queue[w];
+                    if (used + job.mem <= servers[s].memory) {
+                        used += job.mem;
+                        running.push({t + job.duration, job.mem});
+                        end[job.user] = max(end[job.user], t + job.duration);
+                    } else {
+                        waiting[kept++] = w;
+                    }
+                }
+                waiting.resize(kept);
+            }
+        }
+    }
+    
+    int late = 0;
+    double sum = 0;
+    for (int i = 0; i < M; i++) {
+        int moves = 0;
+        for (int j = 1, R = schedules[i].size(); j < R; j++) {
+            if (schedules[i][j].server != schedules[i][j - 1].server || schedules[i][j].npu != schedules[i][j - 1].npu) moves++;
+        }
+        if (end[i] > users[i].end_time) late++;
+        double lateness = (double)(end[i] - users[i].end_time) / (users[i].end_time - users[i].start_time);
+        sum += pow(2.0, -lateness / 100.0) * pow(2.0, -moves / 200.0);
+    }
+    return pow(2.0, -late / 100.0) * sum * 10000;
+}
+
+// 按给定的用户顺序和批次提示依次规划所有用户
+void decode(const uint16_t* order, const uint8_t* hints, vector<vector<Task>>& schedules) {
+    int M = users.size();
+    npu_loads.resize(servers.size());
+    for (int s = 0, S = servers.size(); s < S; s++) {
+        // 原地清空，保留时间线节点池的容量
+        npu_loads[s].resize(servers[s].npus);
+        for (NPULoad& load : npu_loads[s]) {
+            load.total_load = 0;
+            load.timeline.clear();
+        }
+    }
+    schedules.assign(M, {});
+    for (int k = 0; k < M; k++) {
+        int user_id = order[k];
+        schedules[user_id] = generate_optimized_schedule(user_id, hints[user_id]);
+    }
+}
+
+// ---------------- 遗传算法 ----------------
+// 基因组 = 用户规划顺序(排列) + 每个用户的批次提示(0..255)，解码即按顺序调用 generate_optimized_schedule，
+// 适应度为解码方案的精确得分。种群按 [个体][用户] 平铺成两个定长数组(顺序uint16、提示uint8)，
+// 子代由主线程用固定种子的随机数生成，适应度在多个线程上并行计算，结果与线程数无关。
+// 第0个个体是原来的优先级顺序、不缩小批次，精英保留保证结果不差于原规划。
+struct GAParams {
+    int population = 64;
+    int generations = 200;
+    int elite = 2;
+    double crossover_rate = 0.9;
+    double time_limit = 25; // 秒，从程序启动算起，大于0时到时停止；缺省留出题目30秒时限中解码与输出的余量
+};
+
+struct Population {
+    int size = 0;
+    vector<uint16_t> order; // [个体 * M + k]
+    vector<uint8_t> hint;   // [个体 * M + 用户]
+    vector<double> fitness;
+    
+    void resize(int n, int M) {
+        size = n;
+        order.resize((size_t)n * M);
+        hint.resize((size_t)n * M);
+        fitness.assign(n, 0);
+    }
+};
+
+// 并行计算个体 [from, pop.size) 的适应度
+void evaluate_population(Population& pop, int from, int threads) {
+    int M = users.size();
+    atomic<int> next(from);
+    auto work = [&]() {
+        vector<vector<Task>> schedules;
+        for (int g; (g = next++) < pop.size;) {
+            decode(&pop.order[(size_t)g * M], &pop.hint[(size_t)g * M], schedules);
+            pop.fitness[g] = evaluate_schedule(schedules);
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (thread& th : pool) th.join();
+}
+
+// 顺序交叉(OX): 子代保留父代a的一段，其余位置按父代b中的先后顺序填入剩下的用户
+void order_crossover(const uint16_t* a, const uint16_t* b, uint16_t* child, int M, mt19937& rng, vector<char>& used) {
+    int l = rng() % M, r = rng() % M;
+    if (l > r) swap(l, r);
+    fill(used.begin(), used.end(), 0);
+    for (int k = l; k <= r; k++) {
+        child[k] = a[k];
+        used[a[k]] = 1;
+    }
+    int pos = (r + 1) % M;
+    for (int step = 0; step < M; step++) {
+        uint16_t u = b[(r + 1 + step) % M];
+        if (used[u]) continue;
+        child[pos] = u;
+        pos = (pos + 1) % M;
+    }
+}
+
+// start 为程序启动时刻：读入和初始规划也计入 time_limit。每代开始前按已用时间加上最慢一代的耗时判断，
+// 下一代来不及在时限内跑完就停止，不会越过时限
+long long run_ga(const vector<uint16_t>& initial_order, const GAParams& params, int threads, uint64_t seed,
+                 chrono::steady_clock::time_point start, vector<vector<Task>>& best_schedule, double& best_fitness) {
+    auto elapsed = [&]() { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+    int M = users.size();
+    int P = max(params.population, params.elite + 1);
+    mt19937 rng(seed);
+    
+    Population pop, next;
+    pop.resize(P, M);
+    next.resize(P, M);
+    for (int g = 0; g < P; g++) {
+        uint16_t* order = &pop.order[(size_t)g * M];
+        uint8_t* hint = &pop.hint[(size_t)g * M];
+        copy(initial_order.begin(), initial_order.end(), order);
+        fill(hint, hint + M, (uint8_t)BATCH_HINT_MAX);
+        // 其余个体在原顺序上做少量交换、随机缩小少量用户的批次
+        if (g == 0) continue;
+        int swaps = 1 + rng() % max(1, M / 10);
+        for (int k = 0; k < swaps; k++) swap(order[rng() % M], order[rng() % M]);
+        int hinted = rng() % max(1, M / 10);
+        for (int k = 0; k < hinted; k++) hint[rng() % M] = rng() % 256;
+    }
+    double before = elapsed();
+    evaluate_population(pop, 0, threads);
+    long long evaluations = P;
+    // 初始种群的评估次数不少于一代，用它作为最慢一代耗时的初值
+    double slowest = elapsed() - before;
+    
+    vector<int> rank(P);
+    vector<char> used(M);
+    auto tournament = [&]() {
+        int a = rng() % P, b = rng() % P;
+        return pop.fitness[a] > pop.fitness[b] || (pop.fitness[a] == pop.fitness[b] && a < b) ? a : b;
+    };
+    for (int gen = 0; gen < params.generations; gen++) {
+        double gen_start = elapsed();
+        if (params.time_limit > 0 && gen_start + slowest > params.time_limit) break;
+        
+        iota(rank.begin(), rank.end(), 0);
+        stable_sort(rank.begin(), rank.end(), [&](int x, int y) { return pop.fitness[x] > pop.fitness[y]; });
+        for (int g = 0; g < params.elite; g++) {
+            memcpy(&next.order[(size_t)g * M], &pop.order[(size_t)rank[g] * M], M * sizeof(uint16_t));
+            memcpy(&next.hint[(size_t)g * M], &pop.hint[(size_t)rank[g] * M], M);
+            next.fitness[g] = pop.fitness[rank[g]];
+        }
+        for (int g = params.elite; g < P; g++) {
+            int pa = tournament(), pb = tournament();
+            const uint16_t* a = &pop.order[(size_t)pa * M];
+            const uint8_t* ha = &pop.hint[(size_t)pa * M];
+            const uint8_t* hb = &pop.hint[(size_t)pb * M];
+            uint16_t* order = &next.order[(size_t)g * M];
+            uint8_t* hint = &next.hint[(size_t)g * M];
+            if (rng() % 1000 < params.crossover_rate * 1000) {
+                order_crossover(a, &pop.order[(size_t)pb * M], order, M, rng, used);
+                for (int u = 0; u < M; u++) hint[u] = rng() & 1 ? ha[u] : hb[u];
+            } else {
+                memcpy(order, a, M * sizeof(uint16_t));
+                memcpy(hint, ha, M);
+            }
+            // 变异: 把一个用户移到顺序中的另一个位置，并以一半概率改动一个用户的批次提示
+            int from = rng() % M, to = rng() % M;
+            uint16_t moved = order[from];
+            if (from < to) memmove(order + from, order + from + 1, (to - from) * sizeof(uint16_t));
+            else memmove(order + to + 1, order + to, (from - to) * sizeof(uint16_t));
+            order[to] = moved;
+            if (rng() & 1) {
+                int u = rng() % M;
+                hint[u] = rng() % 4 == 0 ? BATCH_HINT_MAX : rng() % 256;
+            }
+        }
+        evaluate_population(next, params.elite, threads);
+        evaluations += P - params.elite;
+        slowest = max(slowest, elapsed() - gen_start);
+        swap(pop, next);
+    }
+    
+    int best = 0;
+    for (int g = 1; g < P; g++) {
+        if (pop.fitness[g] > pop.fitness[best]) best = g;
+    }
+    decode(&pop.order[(size_t)best * M], &pop.hint[(size_t)best * M], best_schedule);
+    best_fitness = pop.fitness[best];
+    return evaluations;
+}
+
+int main(int argc, char* argv[]) {
+    auto program_start = chrono::steady_clock::now();
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
     
+    // --ga: 用遗传算法搜索用户规划顺序和批次提示，缺省按优先级顺序规划一次
+    // --population P / --generations G: 种群大小(缺省64)、代数(缺省200)
+    // --time-limit S: 从程序启动算起最多运行S秒，缺省25(题目时限30秒)，0表示不限时
+    // --threads T: 并行计算适应度的线程数，缺省1(评测按CPU时间计时时多线程会多耗时)
+    // --seed S: 随机种子，缺省为1
+    // --packed-batch: 原批次到达时要排队时改选NPU每毫秒推理样本最多的批次，缺省不改选
+    // --report: 在标准错误输出最优适应度和每秒评估次数
+    bool ga = false, report = false;
+    GAParams ga_params;
+    int threads = 1;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ga") == 0) ga = true;
+        else if (strcmp(argv[i], "--report") == 0) report = true;
+        else if (strcmp(argv[i], "--population") == 0 && i + 1 < argc) ga_params.population = max(3, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--generations") == 0 && i + 1 < argc) ga_params.generations = max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) ga_params.time_limit = atof(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--packed-batch") == 0) packed_batch = true;
+    }
+    
     // 读取输入
     int N;
     cin >> N;
@@ -220,9 +662,22 @@ int main() {
     
     // 生成调度方案
     vector<vector<Task>> all_schedules(M);
-    for (const auto& user_pair : user_order) {
-        int user_id = user_pair.second;
-        all_schedules[user_id] = generate_optimized_schedule(user_id);
+    if (!ga) {
+        for (const auto& user_pair : user_order) {
+            int user_id = user_pair.second;
+            all_schedules[user_id] = generate_optimized_schedule(user_id);
+        }
+    } else {
+        vector<uint16_t> initial_order;
+        for (const auto& user_pair : user_order) initial_order.push_back(user_pair.second);
+        auto start = chrono::steady_clock::now();
+        double best_fitness = 0;
+        long long evaluations = run_ga(initial_order, ga_params, threads, seed, program_start, all_schedules, best_fitness);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (report) {
+            cerr << "ga best fitness: " << best_fitness << ", evaluations: " << evaluations
+                 << ", " << evaluations / max(seconds, 1e-9) << " per second\n";
+        }
     }
     
     // 输出结果